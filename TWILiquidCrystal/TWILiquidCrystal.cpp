@@ -22,15 +22,30 @@
 #include <inttypes.h>
 #include "Arduino.h"
 
+#ifdef __AVR__
+#include <avr/sleep.h>
+#endif
+
 #define TWILCD_DEFAULT_ADDR 50
 
+// What every revision can do, assumed until begin() has asked the display
+static const TWILCDCapabilities default_caps = { 0, 15, 15, 16, 2, 1, 0, 0 };
+
+// highest SCL frequency of the slowest display set up so far, in units of
+// 100kHz, 0 before the first one
+static uint8_t bus_speed;
+
+// commands collected for the next frame in framed mode
+static uint8_t frame[BUFFER_LENGTH];
+static uint8_t frame_length;
+
 LiquidCrystal::LiquidCrystal(uint8_t addr)
-: _addr(addr)
+: _readyPin(-1), _caps(default_caps), _framed(false), _glyphKnown(0), _addr(addr)
 {
 }
 
 LiquidCrystal::LiquidCrystal()
-: _addr(TWILCD_DEFAULT_ADDR)
+: _readyPin(-1), _caps(default_caps), _framed(false), _glyphKnown(0), _addr(TWILCD_DEFAULT_ADDR)
 {  
 }
 
@@ -39,36 +54,39 @@ LiquidCrystal::LiquidCrystal()
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
 			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
 			     uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
-: _addr(TWILCD_DEFAULT_ADDR)
+: _readyPin(-1), _caps(default_caps), _framed(false), _glyphKnown(0), _addr(TWILCD_DEFAULT_ADDR)
 {
 }
 
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t enable,
 			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3,
 			     uint8_t d4, uint8_t d5, uint8_t d6, uint8_t d7)
-: _addr(TWILCD_DEFAULT_ADDR)
+: _readyPin(-1), _caps(default_caps), _framed(false), _glyphKnown(0), _addr(TWILCD_DEFAULT_ADDR)
 {
 }
 
 LiquidCrystal::LiquidCrystal(uint8_t rs, uint8_t rw, uint8_t enable,
 			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
-: _addr(TWILCD_DEFAULT_ADDR)
+: _readyPin(-1), _caps(default_caps), _framed(false), _glyphKnown(0), _addr(TWILCD_DEFAULT_ADDR)
 {
 }
 
 LiquidCrystal::LiquidCrystal(uint8_t rs,  uint8_t enable,
 			     uint8_t d0, uint8_t d1, uint8_t d2, uint8_t d3)
-: _addr(TWILCD_DEFAULT_ADDR)
+: _readyPin(-1), _caps(default_caps), _framed(false), _glyphKnown(0), _addr(TWILCD_DEFAULT_ADDR)
 {
 }
 
 void LiquidCrystal::resetDisplay()
 {
+  _framed = false;
   Wire.beginTransmission(_addr);
   Wire.write(0xFF); // sending some NOP to clear input buffer on display
   Wire.write(0xFF);
   Wire.write(0xFF);
   Wire.write(0xFF);
+  Wire.write(0xF1); // leave framed mode, older revisions print the 0
+  Wire.write(0x00);
   Wire.write(0xFE); // Reset display
   Wire.endTransmission();
 }
@@ -79,6 +97,7 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   delay(200);
   
   resetDisplay();
+  forgetGlyphs();
   if (lines > 1) {
     _displayfunction |= LCD_2LINE;
   }
@@ -105,242 +124,597 @@ void LiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize) {
   command(LCD_ENTRYMODESET | _displaymode);
   delay(50); // OLED needs some more time to initialize
   
-  _firmware_version = getFirmwareVersion();
+  readCapabilities();
   
-  if(_firmware_version >= 2)
+  if(_caps.features & TWILCD_CAP_GEOMETRY)
   {
-	  Wire.beginTransmission(_addr);
-	  Wire.write(0xfd); // Set cols/lines
-	  Wire.write(cols);
-	  Wire.write(lines);
-	  Wire.endTransmission();
+	  beginCommand();
+	  sendByte(0xfd); // Set cols/lines
+	  sendByte(cols);
+	  sendByte(lines);
+	  endCommand();
   }
+  _caps.cols = cols;
+  _caps.rows = lines;
+
+  // run the bus as fast as the slowest display that has been set up allows
+  if(!bus_speed || _caps.max_speed < bus_speed)
+	  bus_speed = _caps.max_speed;
+  if(bus_speed >= 4 && TWILCD_MAX_BUS_SPEED >= 400000L)
+	  setBusSpeed(400000L);
+  else
+	  setBusSpeed(100000L);
   
-  delay(50);
+  waitReady(50);
+}
+
+void LiquidCrystal::readCapabilities()
+{
+  uint8_t rev = getFirmwareVersion();
+
+  _caps = default_caps;
+  _caps.revision = rev;
+
+  // Revisions before 6 do not know the capability command
+  if(rev < 6)
+  {
+    if(rev >= 2)
+      _caps.features |= TWILCD_CAP_GEOMETRY;
+    if(rev >= 3)
+      _caps.features |= TWILCD_CAP_BRIGHTNESS;
+    if(rev >= 4)
+      _caps.features |= TWILCD_CAP_COLOR;
+    return;
+  }
+
+  beginCommand();
+  sendByte(0x8e); // get capabilities
+  endCommand();
+  Wire.requestFrom(_addr, (uint8_t)TWILCD_CAPS_LENGTH);
+  int length = Wire.read();
+  if(Wire.available() < 7 || length < 8)
+    return;
+  _caps.features = Wire.read();
+  _caps.features |= Wire.read() << 8;
+  _caps.rx_buffer = Wire.read();
+  _caps.max_batch = Wire.read();
+  _caps.cols = Wire.read();
+  _caps.rows = Wire.read();
+  _caps.max_speed = Wire.read();
+  if(length >= 9)
+    _caps.max_frame = Wire.read();
+}
+
+// Framed mode sends every command with a length and CRC, see setFramed()
+bool LiquidCrystal::setFramed(bool on)
+{
+  if(!(_caps.features & TWILCD_CAP_FRAMING))
+    return false;
+
+  // 0xf1 is taken outside of frames in either mode
+  Wire.beginTransmission(_addr);
+  Wire.write(0xf1);
+  Wire.write(on);
+  if(Wire.endTransmission())
+    return false;
+  _framed = on;
+  return true;
+}
+
+void LiquidCrystal::beginCommand()
+{
+  if(_framed)
+    frame_length = 0;
+  else
+    Wire.beginTransmission(_addr);
+}
+
+void LiquidCrystal::sendByte(uint8_t value)
+{
+  if(!_framed)
+    Wire.write(value);
+  else if(frame_length < BUFFER_LENGTH - 3)
+    frame[frame_length++] = value;
+}
+
+static uint8_t crc8(uint8_t crc, uint8_t data)
+{
+  crc ^= data;
+  for(uint8_t i = 0; i < 8; i++)
+    crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  return crc;
+}
+
+// In framed mode the commands are sent as a frame and the status is read
+// back. A frame is sent again only when it is known not to have run: the
+// display did not answer to its address, or it answered that the frame was
+// corrupted and dropped. A missing or unknown status is an error, the frame
+// may already have run and sending it twice would repeat its commands.
+uint8_t LiquidCrystal::endCommand()
+{
+  if(!_framed)
+    return Wire.endTransmission();
+
+  uint8_t ret = 4;
+  for(uint8_t retry = 0; retry <= TWILCD_FRAME_RETRIES; retry++)
+  {
+    uint8_t crc = crc8(0, frame_length);
+
+    Wire.beginTransmission(_addr);
+    Wire.write(0xf2); // frame
+    Wire.write(frame_length);
+    for(uint8_t i = 0; i < frame_length; i++)
+    {
+      Wire.write(frame[i]);
+      crc = crc8(crc, frame[i]);
+    }
+    Wire.write(crc);
+    ret = Wire.endTransmission();
+    if(ret == 2)
+      continue; // address not acknowledged, nothing arrived
+    if(ret)
+      return ret;
+
+    Wire.requestFrom(_addr, (uint8_t)1);
+    if(!Wire.available())
+      return 4;
+    uint8_t status = Wire.read();
+    if(status == TWILCD_FRAME_ACK)
+      return 0;
+    if(status != TWILCD_FRAME_NAK)
+      return 4;
+    ret = 4;
+  }
+  return ret;
+}
+
+void LiquidCrystal::setBusSpeed(uint32_t hz)
+{
+#if ARDUINO >= 10600
+  Wire.setClock(hz);
+#elif defined(TWBR)
+  TWBR = ((F_CPU / hz) - 16) / 2; // SCL = F_CPU / (16 + 2 * TWBR), no prescaler
+#endif
+}
+
+static void readyInterrupt()
+{
+  // only here to wake up the CPU in waitReady()
+}
+
+// Use the ready line of a display built with FEATURE_READY, connected to
+// an interrupt capable pin. The line needs a pull-up, the internal one
+// does for short wires. -1 goes back to waiting fixed times.
+void LiquidCrystal::setReadyPin(int8_t pin)
+{
+  if(_readyPin >= 0)
+    detachInterrupt(digitalPinToInterrupt(_readyPin));
+  _readyPin = pin;
+  if(pin < 0)
+    return;
+  pinMode(pin, INPUT_PULLUP);
+  attachInterrupt(digitalPinToInterrupt(pin), readyInterrupt, FALLING);
+}
+
+// Give the display time to finish a slow command, at most ms milliseconds.
+// With a ready line the CPU sleeps until the display pulls it low, which it
+// does once it has executed everything it was sent. Otherwise displays with
+// flow control hold the bus until they can take more, so there is nothing
+// to wait for, and older ones get the full time. Returns false on timeout.
+bool LiquidCrystal::waitReady(uint16_t ms)
+{
+  if(_readyPin < 0)
+  {
+    if(!(_caps.features & TWILCD_CAP_FLOW_CONTROL))
+      delay(ms);
+    return true;
+  }
+
+  unsigned long start = millis();
+  for(;;)
+  {
+    noInterrupts();
+    if(digitalRead(_readyPin) == LOW)
+      break;
+    if(millis() - start >= ms)
+    {
+      interrupts();
+      return false;
+    }
+#ifdef __AVR__
+    // the falling edge or the next timer tick wakes us up, sleep_cpu() runs
+    // before an interrupt that is already pending
+    set_sleep_mode(SLEEP_MODE_IDLE);
+    sleep_enable();
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+#else
+    interrupts();
+#endif
+  }
+  interrupts();
+  return true;
 }
 
 /********** high level commands, for the user! */
 void LiquidCrystal::changeAddress(int new_addr)
 {
-        Wire.beginTransmission(_addr);
-        Wire.write(0x81); // change address
-        Wire.write(new_addr);
-        Wire.endTransmission();
+        beginCommand();
+        sendByte(0x81); // change address
+        sendByte(new_addr);
+        endCommand();
 }
 
 void LiquidCrystal::clear()
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(0x82); // clearscr
-  Wire.endTransmission();
+  beginCommand();
+  sendByte(0x82); // clearscr
+  endCommand();
 }
 
 void LiquidCrystal::home()
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(0x91); // home 
-  Wire.endTransmission();
+  beginCommand();
+  sendByte(0x91); // home 
+  endCommand();
 }
 
 void LiquidCrystal::setCursor(uint8_t col, uint8_t row)
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(0x92); // gotoxy
-  Wire.write(col);
-  Wire.write(row);
-  Wire.endTransmission();
+  beginCommand();
+  sendByte(0x92); // gotoxy
+  sendByte(col);
+  sendByte(row);
+  endCommand();
 }
 
 // Turn the display on/off (quickly)
 void LiquidCrystal::noDisplay() {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x93); // Display off
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x93); // Display off
+	endCommand();
 }
 void LiquidCrystal::display() {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x94); // Display on
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x94); // Display on
+	endCommand();
 }
 
 // Turns the underline cursor on/off
 void LiquidCrystal::noCursor() {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x95); // Cursor off
-	Wire.endTransmission();	
+	beginCommand();
+	sendByte(0x95); // Cursor off
+	endCommand();	
 }
 void LiquidCrystal::cursor() {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x96); // Cursor on
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x96); // Cursor on
+	endCommand();
 }
 
 // Turn on and off the blinking cursor
 void LiquidCrystal::noBlink() {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x97); // Blink off
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x97); // Blink off
+	endCommand();
 }
 void LiquidCrystal::blink() {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x98); // Blink on
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x98); // Blink on
+	endCommand();
 }
 
 // These commands scroll the display without changing the RAM
 void LiquidCrystal::scrollDisplayLeft(void) {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x99); // scroll left
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x99); // scroll left
+	endCommand();
 }
 void LiquidCrystal::scrollDisplayRight(void) {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x9a); // scroll right
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x9a); // scroll right
+	endCommand();
 }
 
 // This is for text that flows Left to Right
 void LiquidCrystal::leftToRight(void) {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x9b); // left to right mode
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x9b); // left to right mode
+	endCommand();
 }
 
 // This is for text that flows Right to Left
 void LiquidCrystal::rightToLeft(void) {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x9c); // right to left mode
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x9c); // right to left mode
+	endCommand();
 }
 
 // This will 'right justify' text from the cursor
 void LiquidCrystal::autoscroll(void) {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x9d); // autoscroll on
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x9d); // autoscroll on
+	endCommand();
 }
 
 // This will 'left justify' text from the cursor
 void LiquidCrystal::noAutoscroll(void) {
-	Wire.beginTransmission(_addr);
-	Wire.write(0x9e); // autoscroll off
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x9e); // autoscroll off
+	endCommand();
 }
 
-// Allows us to fill the first 8 CGRAM locations
-// with custom characters
-void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
-	delay(5);
-	Wire.begin();
-	Wire.beginTransmission(_addr);
-	Wire.write(0x9f); // create custom character
-	Wire.write(location&0x7); // we only have 8 locations 0-7
+// CRC-16-CCITT of the pixels of a glyph, the display ignores bits 5-7
+static uint16_t glyph_hash(const uint8_t charmap[])
+{
+  uint16_t crc = 0xffff;
+
+  for (uint8_t i = 0; i < 8; i++) {
+    crc ^= (uint16_t)(charmap[i] & 0x1f) << 8;
+    for (uint8_t j = 0; j < 8; j++)
+      crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+void LiquidCrystal::loadGlyph(uint8_t location, const uint8_t charmap[], uint16_t hash) {
+	waitReady(5);
+	beginCommand();
+	sendByte(0x9f); // create custom character
+	sendByte(location);
 	
 	for (int i=0; i<8; i++)
-		Wire.write(charmap[i]);
+		sendByte(charmap[i]);
 	
-	Wire.endTransmission();
-	delay(25);
+	endCommand();
+	waitReady(25);
+
+	_glyphHash[location] = hash;
+	_glyphKnown |= 1 << location;
+}
+
+// Allows us to fill the first 8 CGRAM locations
+// with custom characters. A bitmap that is already in the location is not
+// sent again.
+void LiquidCrystal::createChar(uint8_t location, uint8_t charmap[]) {
+	uint16_t hash = glyph_hash(charmap);
+
+	location &= 0x7; // we only have 8 locations 0-7
+	_glyphUsed[location] = ++_glyphTick;
+	if ((_glyphKnown & (1 << location)) && _glyphHash[location] == hash)
+		return;
+	loadGlyph(location, charmap, hash);
+}
+
+// Location of a glyph in CGRAM, for write(). A glyph that is not loaded
+// yet replaces the one drawn least recently. Displays before firmware 6
+// leave the cursor in CGRAM when a glyph is loaded, call setCursor() after
+// glyph() there.
+uint8_t LiquidCrystal::glyph(const uint8_t charmap[]) {
+	uint16_t hash = glyph_hash(charmap);
+	uint16_t age, oldest = 0;
+	uint8_t location = 0;
+
+	for (uint8_t i = 0; i < 8; i++) {
+		if (!(_glyphKnown & (1 << i))) {
+			age = 0xffff; // unknown contents go first
+		} else if (_glyphHash[i] == hash) {
+			_glyphUsed[i] = ++_glyphTick;
+			return i;
+		} else {
+			age = _glyphTick - _glyphUsed[i];
+		}
+		if (age > oldest) {
+			oldest = age;
+			location = i;
+		}
+	}
+
+	loadGlyph(location, charmap, hash);
+	_glyphUsed[location] = ++_glyphTick;
+	return location;
+}
+
+// Draw a glyph at the cursor, loading it when needed
+size_t LiquidCrystal::writeGlyph(const uint8_t charmap[]) {
+	return write(glyph(charmap));
+}
+
+// Load every glyph again, e.g. after the display was power cycled
+void LiquidCrystal::forgetGlyphs() {
+	_glyphKnown = 0;
 }
 
 void LiquidCrystal::saveContrast(uint8_t value)
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(0xd0); // set contrast
-  Wire.write(value);
-  Wire.endTransmission();
-  delay(5); // Wait for the device to activate the setting
+  beginCommand();
+  sendByte(0xd0); // set contrast
+  sendByte(value);
+  endCommand();
+  waitReady(5); // Wait for the device to activate the setting
 }
 
 void LiquidCrystal::setContrast(uint8_t value)
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(0xd1); // set contrast
-  Wire.write(value);
-  Wire.endTransmission();
-  delay(5); // Wait for the device to activate the setting
+  beginCommand();
+  sendByte(0xd1); // set contrast
+  sendByte(value);
+  endCommand();
+  waitReady(5); // Wait for the device to activate the setting
 }
 
 void LiquidCrystal::saveBrightness(uint8_t value)
 {
-  Wire.beginTransmission(_addr);
-  Wire.write(0x80); // set brightness
-  Wire.write(value);
-  Wire.endTransmission();
-  delay(5); // Wait for the device to activate the setting
+  beginCommand();
+  sendByte(0x80); // set brightness
+  sendByte(value);
+  endCommand();
+  waitReady(5); // Wait for the device to activate the setting
 }
 
 void LiquidCrystal::setBrightness(uint8_t value)
 {
-  Wire.beginTransmission(_addr);
-  if(_firmware_version >= 3)
-	Wire.write(0xd3); // set brightness
+  beginCommand();
+  if(_caps.features & TWILCD_CAP_BRIGHTNESS)
+	sendByte(0xd3); // set brightness
   else // Before version 3 there was only saveBrightness
-	Wire.write(0x80); // set brightness
-  Wire.write(value);
-  Wire.endTransmission();
-  delay(5); // Wait for the device to activate the setting
+	sendByte(0x80); // set brightness
+  sendByte(value);
+  endCommand();
+  waitReady(5); // Wait for the device to activate the setting
 }
 
 void LiquidCrystal::saveColor(uint8_t R, uint8_t G, uint8_t B)
 {
-  if(_firmware_version >= 4)
+  if(_caps.features & TWILCD_CAP_COLOR)
   {
-    Wire.beginTransmission(_addr);
-    Wire.write(0xd5); // save RGB
-    Wire.write(R);
-    Wire.write(G);
-    Wire.write(B);
-    Wire.endTransmission();
-    delay(5); // Wait for the eeprom to be written
+    beginCommand();
+    sendByte(0xd5); // save RGB
+    sendByte(R);
+    sendByte(G);
+    sendByte(B);
+    endCommand();
+    waitReady(5); // Wait for the eeprom to be written
   }
 }
 
 void LiquidCrystal::setColor(uint8_t R, uint8_t G, uint8_t B)
 {
-  if(_firmware_version >= 4)
+  if(_caps.features & TWILCD_CAP_COLOR)
   {
-    Wire.beginTransmission(_addr);
-    Wire.write(0xd6); // set RGB
-    Wire.write(R);
-    Wire.write(G);
-    Wire.write(B);
-    Wire.endTransmission();
+    beginCommand();
+    sendByte(0xd6); // set RGB
+    sendByte(R);
+    sendByte(G);
+    sendByte(B);
+    endCommand();
   }
 }
 
 uint8_t LiquidCrystal::getFirmwareVersion()
 {
 	uint8_t rdata = 0;
-	Wire.beginTransmission(_addr);
-	Wire.write(0x8a);
-	Wire.endTransmission();
+	beginCommand();
+	sendByte(0x8a);
+	endCommand();
 	Wire.requestFrom(_addr, (uint8_t)1);
 	if (Wire.available()) rdata = Wire.read();
 	return rdata;
 }
 
+// Where the cursor is, read from the display (firmware revision 6)
+bool LiquidCrystal::getCursor(uint8_t &col, uint8_t &row)
+{
+  // older revisions would print the bytes that follow the unknown command
+  if (_caps.revision < 6)
+    return false;
+  beginCommand();
+  sendByte(0x86); // get cursor position
+  endCommand();
+  if (Wire.requestFrom(_addr, (uint8_t)2) < 2)
+    return false;
+  col = Wire.read();
+  row = Wire.read();
+  return true;
+}
+
+// Read up to size characters of a row from the display into buffer, so the
+// sketch does not need its own copy of the screen. A reply holds at most 14
+// characters and stops at the end of the row. Returns the number read,
+// 0 before firmware revision 6.
+uint8_t LiquidCrystal::readScreen(uint8_t col, uint8_t row, uint8_t *buffer, uint8_t size)
+{
+  uint8_t n = 0;
+
+  if (_caps.revision < 6)
+    return 0;
+
+  while (n < size) {
+    uint8_t chunk = size - n;
+    uint8_t length;
+
+    if (chunk > 14)
+      chunk = 14;
+    beginCommand();
+    sendByte(0x8f); // read screen
+    sendByte(row);
+    sendByte(col + n);
+    sendByte(chunk);
+    endCommand();
+    Wire.requestFrom(_addr, (uint8_t)(chunk + 1));
+    length = Wire.read();
+    if (length > chunk || Wire.available() < length)
+      break;
+    for (uint8_t i = 0; i < length; i++)
+      buffer[n++] = Wire.read();
+    if (length < chunk)
+      break; // end of the row
+  }
+  return n;
+}
+
 /*********** mid level commands, for sending data/cmds */
 
 inline void LiquidCrystal::command(uint8_t value) {
-  Wire.beginTransmission(_addr);
-  Wire.write(0xa3); // send command
-  Wire.write(value);
-  Wire.endTransmission();
+  beginCommand();
+  sendByte(0xa3); // send command
+  sendByte(value);
+  endCommand();
 }
 
 inline size_t LiquidCrystal::write(uint8_t value) {
-  Wire.beginTransmission(_addr);
-  Wire.write(0xa4); // send data
-  Wire.write(value);
-  Wire.endTransmission();
+  beginCommand();
+  sendByte(0xa4); // send data
+  sendByte(value);
+  endCommand();
   return 1;
 }
 
+// Longest transaction the display takes at once
+uint8_t LiquidCrystal::batchLength() {
+  uint8_t batch = BUFFER_LENGTH;
+
+  if (_caps.max_batch && _caps.max_batch < batch)
+    batch = _caps.max_batch;
+  if (_framed && batch > BUFFER_LENGTH - 3)
+    batch = BUFFER_LENGTH - 3;
+  if (_framed && batch > _caps.max_frame)
+    batch = _caps.max_frame;
+  // room for at least one character sent with 0xa4
+  if (batch < 2)
+    batch = 2;
+  return batch;
+}
+
+// Send a buffer in as few transactions as the display allows. Characters
+// that would be taken as commands on their own are sent with 0xa4.
+size_t LiquidCrystal::write(const uint8_t *buffer, size_t size) {
+  uint8_t batch = batchLength();
+  size_t i = 0;
+
+  while (i < size) {
+    uint8_t n = 0;
+
+    beginCommand();
+    while (i < size && n < batch - 1) {
+      uint8_t c = buffer[i++];
+      if (c <= 9 || c >= 0x80) {
+        sendByte(0xa4); // send data
+        n++;
+      }
+      sendByte(c);
+      n++;
+    }
+    endCommand();
+  }
+  return size;
+}
+
 inline void LiquidCrystal::write_raw_data(uint8_t value) {
-  Wire.beginTransmission(_addr);
-  Wire.write(0xa5); // send raw data
-  Wire.write(value);
-  Wire.endTransmission();
+  beginCommand();
+  sendByte(0xa5); // send raw data
+  sendByte(value);
+  endCommand();
 }
 
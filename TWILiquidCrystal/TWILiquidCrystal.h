@@ -5,6 +5,45 @@
 #include "Print.h"
 #include <../Wire/Wire.h>
 
+// Highest SCL frequency begin() may switch the bus to. The bus runs at
+// 400kHz when every display set up so far reports Fast-mode support; set
+// this to 100000L when other devices on the bus only support Standard-mode.
+#ifndef TWILCD_MAX_BUS_SPEED
+#define TWILCD_MAX_BUS_SPEED 400000L
+#endif
+
+// feature flags of TWILCDCapabilities
+#define TWILCD_CAP_GEOMETRY 0x0001     // set columns/rows
+#define TWILCD_CAP_BRIGHTNESS 0x0002   // set brightness without saving it
+#define TWILCD_CAP_COLOR 0x0004        // RGB backlight commands
+#define TWILCD_CAP_SAFEMODE 0x0008     // brightness is limited in safemode
+#define TWILCD_CAP_FLOW_CONTROL 0x0010 // the display holds the bus instead of dropping bytes
+#define TWILCD_CAP_PROFILING 0x0020    // performance counters
+#define TWILCD_CAP_FRAMING 0x0040      // framed commands with CRC, see setFramed()
+
+// bytes of the capability record read by begin()
+#define TWILCD_CAPS_LENGTH 9
+
+// status the display answers a frame with in framed mode
+#define TWILCD_FRAME_ACK 0x06
+#define TWILCD_FRAME_NAK 0x15
+
+// how often a frame that did not arrive, or arrived corrupted, is sent again
+#ifndef TWILCD_FRAME_RETRIES
+#define TWILCD_FRAME_RETRIES 2
+#endif
+
+struct TWILCDCapabilities {
+  uint16_t features;  // TWILCD_CAP_ flags
+  uint8_t rx_buffer;  // number of bytes the receive buffer of the display holds
+  uint8_t max_batch;  // longest write that is safe to send, 0 for no limit
+  uint8_t cols;
+  uint8_t rows;
+  uint8_t max_speed;  // highest SCL frequency, in units of 100kHz
+  uint8_t max_frame;  // longest frame, 0 without framing
+  uint8_t revision;   // firmware revision
+};
+
 // commands
 #define LCD_CLEARDISPLAY 0x01
 #define LCD_RETURNHOME 0x02
@@ -65,8 +104,8 @@ public:
   void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
   void changeAddress(int new_addr);
 
-  void clear();
-  void home();
+  virtual void clear();
+  virtual void home();
 
   void noDisplay();
   void display();
@@ -82,8 +121,12 @@ public:
   void noAutoscroll();
 
   void createChar(uint8_t, uint8_t[]);
-  void setCursor(uint8_t, uint8_t); 
+  uint8_t glyph(const uint8_t[]);
+  size_t writeGlyph(const uint8_t[]);
+  void forgetGlyphs();
+  virtual void setCursor(uint8_t, uint8_t); 
   virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *, size_t);
   void command(uint8_t);
   
   void saveContrast(uint8_t);
@@ -93,13 +136,36 @@ public:
   void saveColor(uint8_t, uint8_t, uint8_t);
   void setColor(uint8_t, uint8_t, uint8_t);
   uint8_t getFirmwareVersion();
+  virtual bool getCursor(uint8_t &col, uint8_t &row);
+  uint8_t readScreen(uint8_t col, uint8_t row, uint8_t *buffer, uint8_t size);
+  const TWILCDCapabilities& getCapabilities() { return _caps; }
+  bool setFramed(bool);
+  void setReadyPin(int8_t);
+  virtual bool waitReady(uint16_t);
+protected:
+  // every command goes through these, AsyncLiquidCrystal queues it instead
+  virtual void beginCommand();
+  virtual void sendByte(uint8_t);
+  virtual uint8_t endCommand();
+  uint8_t batchLength();
+  int8_t _readyPin;         // input for the ready line of the display, -1 for none
 private:
   void resetDisplay();
+  void readCapabilities();
+  void setBusSpeed(uint32_t);
   void write_raw_data(uint8_t);
+  void loadGlyph(uint8_t, const uint8_t[], uint16_t);
   uint8_t _displayfunction;
   uint8_t _displaycontrol;
   uint8_t _displaymode;
-  uint8_t _firmware_version;
+  TWILCDCapabilities _caps;
+  bool _framed;
+
+  // what the library loaded into the 8 CGRAM slots
+  uint16_t _glyphHash[8];   // hash of the bitmap in each slot
+  uint16_t _glyphUsed[8];   // _glyphTick when the slot was last drawn
+  uint16_t _glyphTick;
+  uint8_t _glyphKnown;      // slots whose contents are known
   
   uint8_t _addr;
 };
@@ -0,0 +1,386 @@
+/*
+ * TWI LCD Character Display - Arduino Library
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#include "TWILiquidCrystalAsync.h"
+
+#include <string.h>
+#include "Arduino.h"
+
+AsyncLiquidCrystal::AsyncLiquidCrystal(uint8_t addr)
+: LiquidCrystal(addr), _queued(0), _last(0xff), _direct(true), _urgent(false),
+  _cols(0), _rows(0), _col(0), _row(0), _cursorShown(0), _cursorMoved(false),
+  _at(0xff), _sent(0), _hold(0)
+{
+  memset(_dirty, 0, sizeof(_dirty));
+}
+
+AsyncLiquidCrystal::AsyncLiquidCrystal()
+: _queued(0), _last(0xff), _direct(true), _urgent(false),
+  _cols(0), _rows(0), _col(0), _row(0), _cursorShown(0), _cursorMoved(false),
+  _at(0xff), _sent(0), _hold(0)
+{
+  memset(_dirty, 0, sizeof(_dirty));
+}
+
+// Set up the display the same way as LiquidCrystal, this waits for it
+void AsyncLiquidCrystal::begin(uint8_t cols, uint8_t lines, uint8_t dotsize)
+{
+  flush(0xffff);
+  _direct = true;
+  LiquidCrystal::begin(cols, lines, dotsize);
+  _direct = false;
+
+  if (cols * lines > TWILCD_ASYNC_CELLS)
+    lines = TWILCD_ASYNC_CELLS / cols;
+  _cols = cols;
+  _rows = lines;
+  memset(_cells, ' ', sizeof(_cells));
+  memset(_dirty, 0, sizeof(_dirty));
+  _col = _row = 0;
+  _cursorShown = 0;
+  _cursorMoved = false;
+  _at = 0xff;
+}
+
+// LiquidCrystal::begin() calls these, then they go to the display
+void AsyncLiquidCrystal::clear()
+{
+  LiquidCrystal::clear();
+  if (_direct)
+    return;
+  memset(_cells, ' ', sizeof(_cells));
+  memset(_dirty, 0, sizeof(_dirty)); // the text before the clear is gone
+  _col = _row = 0;
+  _cursorMoved = false;
+}
+
+void AsyncLiquidCrystal::home()
+{
+  if (_direct)
+    LiquidCrystal::home();
+  else
+    setCursor(0, 0);
+}
+
+void AsyncLiquidCrystal::setCursor(uint8_t col, uint8_t row)
+{
+  if (_direct) {
+    LiquidCrystal::setCursor(col, row);
+    return;
+  }
+  _col = col;
+  _row = row;
+  _cursorMoved = true;
+}
+
+// Where the next character goes, the display itself is not asked
+bool AsyncLiquidCrystal::getCursor(uint8_t &col, uint8_t &row)
+{
+  if (_direct)
+    return LiquidCrystal::getCursor(col, row);
+  col = _col;
+  row = _row;
+  return true;
+}
+
+size_t AsyncLiquidCrystal::write(uint8_t value)
+{
+  if (value == '\r') {
+    _col = 0;
+  } else if (value == '\n') {
+    _col = 0;
+    _row++;
+  } else {
+    if (_col < _cols && _row < _rows) {
+      uint8_t cell = _row * _cols + _col;
+
+      if (_cells[cell] != value) {
+        _cells[cell] = value;
+        _dirty[cell >> 3] |= 1 << (cell & 7);
+      }
+    }
+    _col++;
+  }
+  return 1;
+}
+
+size_t AsyncLiquidCrystal::write(const uint8_t *buffer, size_t size)
+{
+  for (size_t i = 0; i < size; i++)
+    write(buffer[i]);
+  return size;
+}
+
+// The commands that follow go before the others when on
+void AsyncLiquidCrystal::setUrgent(bool on)
+{
+  _urgent = on;
+}
+
+// Slow commands make the following transactions wait, without blocking
+bool AsyncLiquidCrystal::waitReady(uint16_t ms)
+{
+  if (_direct)
+    return LiquidCrystal::waitReady(ms);
+
+  if (ms > 0xff)
+    ms = 0xff;
+  if (_last < _queued) {
+    if (_queue[_last].hold < ms)
+      _queue[_last].hold = ms; // where the command went, it may have replaced one
+  } else if (_hold < ms) {
+    _hold = ms; // for what was sent last
+  }
+  return true;
+}
+
+void AsyncLiquidCrystal::beginCommand()
+{
+  if (_direct)
+    LiquidCrystal::beginCommand();
+  else
+    _command.length = 0;
+}
+
+void AsyncLiquidCrystal::sendByte(uint8_t value)
+{
+  if (_direct)
+    LiquidCrystal::sendByte(value);
+  else if (_command.length < TWILCD_QUEUE_ENTRY)
+    _command.data[_command.length++] = value;
+}
+
+// Settings of which only the last one matters, 0 for other commands
+static uint8_t settingGroup(uint8_t op)
+{
+  switch (op) {
+    case 0x93: case 0x94: // display off/on
+      return 0x93;
+    case 0x95: case 0x96: // cursor off/on
+      return 0x95;
+    case 0x97: case 0x98: // blink off/on
+      return 0x97;
+    case 0x80: case 0xd0: case 0xd1: case 0xd3: case 0xd5: case 0xd6: // backlight and contrast
+      return op;
+  }
+  return 0;
+}
+
+uint8_t AsyncLiquidCrystal::endCommand()
+{
+  uint8_t op, group;
+
+  if (_direct)
+    return LiquidCrystal::endCommand();
+  if (!_command.length)
+    return 0;
+  op = _command.data[0];
+  group = settingGroup(op);
+
+  switch (op) {
+    case 0x86: case 0x8a: case 0x8c: case 0x8e: case 0x8f:
+      // the reply is read right after the command
+      flush(0xffff);
+      while (holding())
+        ;
+      _command.hold = 0;
+      _last = 0xff;
+      return send(_command);
+    case 0x95: _cursorShown &= ~LCD_CURSORON; break;
+    case 0x96: _cursorShown |= LCD_CURSORON; break;
+    case 0x97: _cursorShown &= ~LCD_BLINKON; break;
+    case 0x98: _cursorShown |= LCD_BLINKON; break;
+  }
+
+  _command.urgent = _urgent;
+  _command.hold = 0;
+
+  // replace the same setting unless another command came after it
+  for (uint8_t i = _queued; group && i-- > 0; ) {
+    uint8_t g = settingGroup(_queue[i].data[0]);
+
+    if (!g)
+      break;
+    if (g == group && _queue[i].urgent == _urgent) {
+      _command.hold = _queue[i].hold;
+      _queue[i] = _command;
+      _last = i;
+      return 0;
+    }
+  }
+
+  // a full queue makes room with one transaction
+  if (_queued == TWILCD_QUEUE_LENGTH) {
+    while (holding())
+      ;
+    poll();
+  }
+  _last = _queued;
+  _queue[_queued++] = _command;
+  return 0;
+}
+
+// Whether the display still needs time for the last transaction
+bool AsyncLiquidCrystal::holding()
+{
+  if (_readyPin >= 0) {
+    if (digitalRead(_readyPin) == LOW)
+      return false;
+    return millis() - _sent < TWILCD_READY_TIMEOUT;
+  }
+  return _hold && millis() - _sent < _hold;
+}
+
+uint8_t AsyncLiquidCrystal::send(const Entry &e)
+{
+  uint8_t ret;
+
+  LiquidCrystal::beginCommand();
+  for (uint8_t i = 0; i < e.length; i++)
+    LiquidCrystal::sendByte(e.data[i]);
+  ret = LiquidCrystal::endCommand();
+  _sent = millis();
+  _hold = e.hold;
+  _at = 0xff; // the command may move the cursor
+  return ret;
+}
+
+void AsyncLiquidCrystal::sendEntry(uint8_t i)
+{
+  Entry e = _queue[i];
+
+  _queued--;
+  memmove(&_queue[i], &_queue[i + 1], (_queued - i) * sizeof(Entry));
+  if (_last == i)
+    _last = 0xff;
+  else if (_last != 0xff && _last > i)
+    _last--;
+  send(e);
+}
+
+// Send the changed text of one line from its first changed character on,
+// as far as one transaction goes. Unchanged characters in between are sent
+// along rather than starting another transaction, and the gotoxy is left
+// out when the display already writes to that cell. A batch too short for
+// the gotoxy and the first character sends the gotoxy alone.
+bool AsyncLiquidCrystal::sendCells()
+{
+  uint8_t batch = batchLength();
+  uint8_t cell, end, last, used, i, c;
+
+  for (cell = 0; cell < _cols * _rows && !dirty(cell); cell++)
+    ;
+  if (cell == _cols * _rows)
+    return false;
+
+  end = (cell / _cols + 1) * _cols;
+  last = cell;
+  used = cell == _at ? 0 : 3;
+  c = _cells[cell];
+  if (used + ((c <= 9 || c >= 0x80) ? 2 : 1) > batch)
+    last = 0xff; // gotoxy only
+  for (i = cell; i < end && last != 0xff; i++) {
+    c = _cells[i];
+    used += (c <= 9 || c >= 0x80) ? 2 : 1;
+    if (used > batch)
+      break;
+    if (dirty(i))
+      last = i;
+  }
+
+  LiquidCrystal::beginCommand();
+  if (cell != _at) {
+    LiquidCrystal::sendByte(0x92); // gotoxy
+    LiquidCrystal::sendByte(cell % _cols);
+    LiquidCrystal::sendByte(cell / _cols);
+  }
+  for (i = cell; last != 0xff && i <= last; i++) {
+    c = _cells[i];
+    if (c <= 9 || c >= 0x80)
+      LiquidCrystal::sendByte(0xa4); // send data
+    LiquidCrystal::sendByte(c);
+    _dirty[i >> 3] &= ~(1 << (i & 7));
+  }
+  LiquidCrystal::endCommand();
+
+  _sent = millis();
+  _hold = 0;
+  _cursorMoved = true;
+  if (last == 0xff)
+    _at = cell;
+  else
+    _at = last + 1 < end ? last + 1 : 0xff; // the end of a line is not followed by the next one
+  return true;
+}
+
+// Send the next transaction, if the display is ready for it. Returns
+// whether one was sent.
+bool AsyncLiquidCrystal::poll()
+{
+  if (holding())
+    return false;
+  _hold = 0;
+
+  if (_queued) {
+    uint8_t i;
+
+    for (i = 0; i < _queued && !_queue[i].urgent; i++)
+      ;
+    sendEntry(i < _queued ? i : 0);
+    return true;
+  }
+
+  if (sendCells())
+    return true;
+
+  // put a visible cursor back where the sketch left it
+  if (_cursorShown && _cursorMoved) {
+    Entry e;
+
+    e.length = 3;
+    e.hold = 0;
+    e.data[0] = 0x92; // gotoxy
+    e.data[1] = _col;
+    e.data[2] = _row;
+    send(e);
+    _cursorMoved = false;
+    return true;
+  }
+  return false;
+}
+
+// Whether everything has been sent
+bool AsyncLiquidCrystal::idle()
+{
+  uint8_t i;
+
+  for (i = 0; i < sizeof(_dirty) && !_dirty[i]; i++)
+    ;
+  return !_queued && i == sizeof(_dirty) && !(_cursorShown && _cursorMoved);
+}
+
+// Send what is waiting, for at most timeout ms. Returns whether all of it
+// was sent.
+bool AsyncLiquidCrystal::flush(uint16_t timeout)
+{
+  unsigned long start = millis();
+
+  while (!idle()) {
+    if (millis() - start >= timeout)
+      return false;
+    poll();
+  }
+  return true;
+}
@@ -0,0 +1,111 @@
+/*
+ * TWI LCD Character Display - Arduino Library
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifndef LiquidCrystalAsync_h
+#define LiquidCrystalAsync_h
+
+#include "TWILiquidCrystal.h"
+
+// commands that can wait in the queue, and the longest one (create character)
+#ifndef TWILCD_QUEUE_LENGTH
+#define TWILCD_QUEUE_LENGTH 8
+#endif
+#define TWILCD_QUEUE_ENTRY 10
+
+// characters of the copy of the screen, enough for 20x4 and 40x2
+#ifndef TWILCD_ASYNC_CELLS
+#define TWILCD_ASYNC_CELLS 80
+#endif
+
+// longest time to wait for the ready line after a transaction, in ms
+#define TWILCD_READY_TIMEOUT 50
+
+// A LiquidCrystal that does not make loop() wait for the display. Commands
+// are queued in RAM and text is written to a copy of the screen. Each call
+// of poll() sends at most one transaction:
+//  - commands given after setUrgent(true) go first, then the others in the
+//    order they were given, then the text that changed
+//  - text overwritten before it was sent is not sent at all, and a setting
+//    (brightness, display on/off, ...) given again replaces the queued one
+//  - the time the display needs after a slow command is waited out by the
+//    following calls of poll(). With setReadyPin() nothing is sent until
+//    the display is ready, so the bus is never held either.
+// begin(), and commands that read from the display, send what is queued
+// first and block. A command given while the queue is full sends one
+// transaction to make room. Text is written left to right and clipped at
+// the end of the line, the commands that change the entry mode are not
+// available.
+class AsyncLiquidCrystal : public LiquidCrystal {
+public:
+  AsyncLiquidCrystal(uint8_t addr);
+  AsyncLiquidCrystal();
+
+  void begin(uint8_t cols, uint8_t rows, uint8_t charsize = LCD_5x8DOTS);
+  virtual void clear();
+  virtual void home();
+  virtual void setCursor(uint8_t, uint8_t);
+  virtual bool getCursor(uint8_t &col, uint8_t &row);
+  virtual size_t write(uint8_t);
+  virtual size_t write(const uint8_t *, size_t);
+  virtual bool waitReady(uint16_t);
+
+  void setUrgent(bool);
+  bool poll();
+  bool flush(uint16_t timeout);
+  bool idle();
+protected:
+  virtual void beginCommand();
+  virtual void sendByte(uint8_t);
+  virtual uint8_t endCommand();
+private:
+  // text is always written left to right
+  using LiquidCrystal::leftToRight;
+  using LiquidCrystal::rightToLeft;
+  using LiquidCrystal::autoscroll;
+  using LiquidCrystal::noAutoscroll;
+
+  struct Entry {
+    uint8_t length;
+    bool urgent;
+    uint8_t hold;             // ms the display needs afterwards
+    uint8_t data[TWILCD_QUEUE_ENTRY];
+  };
+
+  bool holding();
+  uint8_t send(const Entry &);
+  void sendEntry(uint8_t);
+  bool sendCells();
+  bool dirty(uint8_t cell) { return _dirty[cell >> 3] & (1 << (cell & 7)); }
+
+  Entry _queue[TWILCD_QUEUE_LENGTH];
+  uint8_t _queued;
+  uint8_t _last;              // entry of the last command given, 0xff once sent
+  Entry _command;             // being built by beginCommand()/sendByte()
+  bool _direct;               // commands are sent right away
+  bool _urgent;
+
+  uint8_t _cells[TWILCD_ASYNC_CELLS];
+  uint8_t _dirty[(TWILCD_ASYNC_CELLS + 7) / 8];
+  uint8_t _cols, _rows;
+  uint8_t _col, _row;         // where the next character goes
+  uint8_t _cursorShown;       // LCD_CURSORON and LCD_BLINKON as last queued
+  bool _cursorMoved;          // the cursor of the display is elsewhere
+  uint8_t _at;                // cell the display writes to next, 0xff if not known
+
+  unsigned long _sent;        // millis() of the last transaction
+  uint8_t _hold;
+};
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_GLYPHS
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "glyph.h"
+#include "lcd.h"
+
+#define GLYPH_NONE      0xff
+
+static const PROGMEM uint8_t bank[GLYPH_COUNT][8] =
+{
+	{ 0x04, 0x0e, 0x0e, 0x0e, 0x1f, 0x00, 0x04, 0x00 },  // bell
+	{ 0x00, 0x0a, 0x1f, 0x1f, 0x0e, 0x04, 0x00, 0x00 },  // heart
+	{ 0x00, 0x01, 0x03, 0x16, 0x1c, 0x08, 0x00, 0x00 },  // check mark
+	{ 0x00, 0x1b, 0x0e, 0x04, 0x0e, 0x1b, 0x00, 0x00 },  // cross
+	{ 0x04, 0x0e, 0x15, 0x04, 0x04, 0x04, 0x04, 0x00 },  // arrow up
+	{ 0x04, 0x04, 0x04, 0x04, 0x15, 0x0e, 0x04, 0x00 },  // arrow down
+	{ 0x0e, 0x11, 0x11, 0x1f, 0x1b, 0x1b, 0x1f, 0x00 },  // lock
+	{ 0x0e, 0x10, 0x10, 0x1f, 0x1b, 0x1b, 0x1f, 0x00 },  // lock open
+	{ 0x0e, 0x1b, 0x11, 0x11, 0x11, 0x11, 0x1f, 0x00 },  // battery empty
+	{ 0x0e, 0x1b, 0x11, 0x11, 0x1f, 0x1f, 0x1f, 0x00 },  // battery half
+	{ 0x0e, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x1f, 0x00 },  // battery full
+	{ 0x00, 0x01, 0x01, 0x05, 0x05, 0x15, 0x15, 0x00 },  // signal
+	{ 0x00, 0x0e, 0x15, 0x17, 0x11, 0x0e, 0x00, 0x00 },  // clock
+	{ 0x01, 0x03, 0x1f, 0x1f, 0x1f, 0x03, 0x01, 0x00 },  // speaker
+	{ 0x08, 0x0c, 0x0e, 0x0f, 0x0e, 0x0c, 0x08, 0x00 },  // play
+	{ 0x1b, 0x1b, 0x1b, 0x1b, 0x1b, 0x1b, 0x1b, 0x00 },  // pause
+};
+
+static uint8_t resident[GLYPH_SLOTS] = {   // glyph in each slot
+	GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE,
+	GLYPH_NONE, GLYPH_NONE, GLYPH_NONE, GLYPH_NONE
+};
+static uint8_t lru[GLYPH_SLOTS] = { 0, 1, 2, 3, 4, 5, 6, 7 }; // slots, most recently used first
+static uint8_t pinned;                      // slots loaded by the host
+
+// Slot to load a glyph into, GLYPH_NONE when the host has all of them
+static uint8_t glyph_victim(void)
+{
+	uint8_t busy = pinned;
+	uint8_t i;
+
+#ifndef LCD_WRITE_ONLY
+	busy |= lcd_cgram_visible();
+#endif
+	for (i = GLYPH_SLOTS; i-- > 0; )
+		if (!(busy & _BV(lru[i])))
+			return lru[i];
+
+	// everything is on the screen, the oldest of the bank's slots changes
+	for (i = GLYPH_SLOTS; i-- > 0; )
+		if (!(pinned & _BV(lru[i])))
+			return lru[i];
+
+	return GLYPH_NONE;
+}
+
+// Move a slot to the front of the LRU order
+static void glyph_touch(uint8_t slot)
+{
+	uint8_t i = 0;
+
+	while (lru[i] != slot)
+		i++;
+	for (; i > 0; i--)
+		lru[i] = lru[i - 1];
+	lru[0] = slot;
+}
+
+void glyph_show(uint8_t id)
+{
+	uint8_t slot;
+
+	if (id >= GLYPH_COUNT)
+		return;
+
+	for (slot = 0; slot < GLYPH_SLOTS; slot++)
+		if (resident[slot] == id && !(pinned & _BV(slot)))
+			break;
+
+	if (slot == GLYPH_SLOTS) {
+		slot = glyph_victim();
+		if (slot == GLYPH_NONE)
+			return;
+		lcd_createCharacter_p(slot, bank[id]);
+		resident[slot] = id;
+	}
+
+	glyph_touch(slot);
+	lcd_putc(slot);
+}
+
+// The host loaded its own character into a slot
+void glyph_pin(uint8_t slot)
+{
+	pinned |= _BV(slot);
+	resident[slot] = GLYPH_NONE;
+}
+
+void glyph_release(void)
+{
+	uint8_t i;
+
+	pinned = 0;
+	for (i = 0; i < GLYPH_SLOTS; i++)
+		resident[i] = GLYPH_NONE;
+}
+
+#endif // FEATURE_GLYPHS
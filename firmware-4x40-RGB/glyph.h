@@ -0,0 +1,62 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Glyph bank (FEATURE_GLYPHS)
+ *
+ * GLYPH_COUNT icons are kept in program memory and loaded into the eight
+ * CGRAM slots when they are used:
+ *
+ *   0xea <id>   show glyph <id> at the cursor
+ *   0xeb        give all slots back to the bank and forget their contents,
+ *               also after CGRAM was changed by a snapshot or a register
+ *               write
+ *
+ * A glyph that is not in CGRAM goes to the least recently used slot that
+ * is not on the screen, so what is shown does not change. When all slots
+ * are on the screen the least recently used one is taken anyway. Slots
+ * loaded by the host with 0x9f are left alone until 0xeb.
+ *
+ * Without LCD readback (LCD_WRITE_ONLY) the screen cannot be checked and
+ * the least recently used slot is always taken.
+ *
+ *   id  glyph          id  glyph
+ *    0  bell            8  battery empty
+ *    1  heart           9  battery half
+ *    2  check mark     10  battery full
+ *    3  cross          11  signal
+ *    4  arrow up       12  clock
+ *    5  arrow down     13  speaker
+ *    6  lock           14  play
+ *    7  lock open      15  pause
+ */
+
+#ifndef GLYPH_H__
+#define GLYPH_H__
+
+#ifdef FEATURE_GLYPHS
+
+#include <avr/io.h>
+
+#define GLYPH_COUNT     16
+#define GLYPH_SLOTS     8
+
+void glyph_show(uint8_t id);
+void glyph_pin(uint8_t slot);
+void glyph_release(void);
+
+#endif // FEATURE_GLYPHS
+
+#endif // GLYPH_H__
@@ -27,6 +27,7 @@
 #include <inttypes.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <util/delay_basic.h>
 #include "lcd.h"
 
 /* 
@@ -36,13 +37,19 @@
 #define PIN(x) (*(&x - 2))    /* address of input register of port x          */
 
 
+#ifndef lcd_e_delay
 #define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
+#endif
 #define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
 #define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
 #define lcd_e_toggle()  toggle_e()
 #define lcd_e2_high()    LCD_E2_PORT  |=  _BV(LCD_E2_PIN);
 #define lcd_e2_low()     LCD_E2_PORT  &= ~_BV(LCD_E2_PIN);
 #define lcd_e2_toggle()  toggle_e2()
+/* E of the first (e2 = 0) or of the second controller (e2 = 1) */
+#define lcd_ex_high(e2)   do { if (e2) { lcd_e2_high(); } else { lcd_e_high(); } } while (0)
+#define lcd_ex_low(e2)    do { if (e2) { lcd_e2_low(); } else { lcd_e_low(); } } while (0)
+#define lcd_ex_toggle(e2) do { if (e2) lcd_e2_toggle(); else lcd_e_toggle(); } while (0)
 #define lcd_rw_high()   LCD_RW_PORT |=  _BV(LCD_RW_PIN)
 #define lcd_rw_low()    LCD_RW_PORT &= ~_BV(LCD_RW_PIN)
 #define lcd_rs_high()   LCD_RS_PORT |=  _BV(LCD_RS_PIN)
@@ -52,6 +59,8 @@ uint8_t lcd_lines = 2;              /**< number of visible lines of the display
 uint8_t lcd_disp_length = 16;       /**< visibles characters per line of the display */
 uint8_t lcd_controller_ks0073 = 0;  /**< Use 0 for HD44780 controller, 1 for KS0073 controller */
 uint8_t lcd_wrap_lines = 0;         /**< 0: no wrap, 1: wrap at end of visibile line */
+uint8_t lcd_split_line = 0;         /**< 1: one line panel addressed as two half lines (16x1) */
+uint8_t lcd_span_length = 16;       /**< characters of a line that follow each other in DDRAM */
 
 // initialize display control: display on, cursor off, blink off
 uint8_t displaycontrol = LCD_DISPLAYCONTROL | LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF;
@@ -71,6 +80,49 @@ volatile struct lcd2CtrlMode mode;
 #define KS0073_EXTENDED_FUNCTION_REGISTER_ON  0x24   /* |0|010|0100 4-bit mode extension-bit RE = 1 */
 #define KS0073_EXTENDED_FUNCTION_REGISTER_OFF 0x20   /* |0|000|1001 4 lines mode */
 #define KS0073_4LINES_MODE                    0x09   /* |0|001|0000 4-bit mode, extension-bit RE = 0 */
+#define KS0073_RE                             0x04   /* function set: extension-bit RE */
+#define KS0073_NW                             0x01   /* extended function set: 4 lines mode */
+
+/*
+** controller state cache: the last value written to each instruction register,
+** used to drop instructions that would not change the state of the controller
+*/
+#define LCD_STATE_UNKNOWN 0xFF
+
+struct lcdState {
+	uint8_t function;         /**< last function set instruction */
+	uint8_t entrymode;        /**< last entry mode set instruction */
+	uint8_t displaycontrol;   /**< last display on/off control instruction */
+	uint8_t cgram:1;          /**< 1: address counter points into CG RAM */
+	uint8_t ks0073_4lines:1;  /**< 1: KS0073 4 lines mode is enabled */
+	uint8_t written:1;        /**< 1: data written, or display cleared, since the last address set or data read */
+};
+
+static struct lcdState lcd_state[2];  /**< [0]: first controller (E), [1]: second controller (E2) */
+
+/*
+** display geometry, built by lcd_setup(): the DDRAM address each segment of
+** the display starts at and the controller it is on. A line is one segment,
+** or two with split addressing.
+*/
+#define LCD_SEGMENTS 4
+
+struct lcdGeometry {
+	uint8_t start[LCD_SEGMENTS]; /**< DDRAM address of the first character of each segment */
+	uint8_t end[LCD_SEGMENTS];   /**< address counter after the last character of each segment */
+	uint8_t second;           /**< bit n set: segment n is on the second controller */
+	uint8_t count;            /**< segments in use */
+	uint8_t split;            /**< 1: two segments per line */
+	uint8_t cursor;           /**< segment the cursor was put into last */
+};
+
+static struct lcdGeometry lcd_geom = { { 0x00, 0x40 }, { 0x10, 0x50 }, 0, 2, 0, 0 };
+
+/* the cursor is on the second controller */
+#define lcd_second_active()     (mode.enable && mode.display == 1)
+
+/* segment <i> is on the controller the cursor is on */
+#define lcd_segment_active(i)   ( ((lcd_geom.second >> (i)) & 1) == lcd_second_active() )
 
 
 /* 
@@ -90,15 +142,8 @@ static void toggle_e2(void);
 *************************************************************************/
 static inline void _delayFourCycles(unsigned int __count)
 {
-    if ( __count == 0 )    
-        __asm__ __volatile__( "rjmp 1f\n 1:" );    // 2 cycles
-    else
-        __asm__ __volatile__ (
-    	    "1: sbiw %0,1" "\n\t"                  
-    	    "brne 1b"                              // 4 cycles/loop
-    	    : "=w" (__count)
-    	    : "0" (__count)
-    	   );
+    if ( __count )                         // a count of 0 would loop 65536 times
+        _delay_loop_2(__count);            // 4 cycles/loop
 }
 
 
@@ -129,9 +174,10 @@ Low-level function to write byte to LCD controller
 Input:    data   byte to write to LCD
           rs     1: write data    
                  0: write instruction
+          e2     1: second controller (E2)
 Returns:  none
 *************************************************************************/
-static void lcd_write(uint8_t data,uint8_t rs) 
+static void lcd_write_e(uint8_t data,uint8_t rs,uint8_t e2) 
 {
     unsigned char dataBits ;
 
@@ -152,11 +198,11 @@ static void lcd_write(uint8_t data,uint8_t rs)
         /* output high nibble first */
         dataBits = LCD_DATA0_PORT & 0xF0;
         LCD_DATA0_PORT = dataBits |((data>>4)&0x0F);
-        lcd_e_toggle();
+        lcd_ex_toggle(e2);
 
         /* output low nibble */
         LCD_DATA0_PORT = dataBits | (data&0x0F);
-        lcd_e_toggle();
+        lcd_ex_toggle(e2);
 
         /* all data pins high (inactive) */
         LCD_DATA0_PORT = dataBits | 0x0F;
@@ -178,7 +224,7 @@ static void lcd_write(uint8_t data,uint8_t rs)
     	if(data & 0x40) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
     	if(data & 0x20) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
     	if(data & 0x10) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);   
-        lcd_e_toggle();
+        lcd_ex_toggle(e2);
         
         /* output low nibble */
         LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
@@ -189,7 +235,7 @@ static void lcd_write(uint8_t data,uint8_t rs)
     	if(data & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
     	if(data & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
     	if(data & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
-        lcd_e_toggle();        
+        lcd_ex_toggle(e2);        
         
         /* all data pins high (inactive) */
         LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
@@ -197,43 +243,33 @@ static void lcd_write(uint8_t data,uint8_t rs)
         LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
         LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
     }
+
+    /* the controller loads its data register from the RAM on an address set,
+       after a data write, clear or home it still holds something else */
+    if (rs || data < (1<<LCD_ENTRY_MODE))
+        lcd_state[e2].written = 1;
+    else if ( data & ((1<<LCD_DDRAM)|(1<<LCD_CGRAM)) )
+        lcd_state[e2].written = 0;
 }
 
-static void lcd_write2(uint8_t data,uint8_t rs) 
+static void lcd_write(uint8_t data,uint8_t rs)
 {
-    unsigned char dataBits ;
-
-
-    if (rs) {   /* write data        (RS=1, RW=0) */
-       lcd_rs_high();
-    } else {    /* write instruction (RS=0, RW=0) */
-       lcd_rs_low();
-    }
-    lcd_rw_low();
-
-    /* configure data pins as output */
-    DDR(LCD_DATA0_PORT) |= 0x0F;
-
-    /* output high nibble first */
-    dataBits = LCD_DATA0_PORT & 0xF0;
-    LCD_DATA0_PORT = dataBits |((data>>4)&0x0F);
-    lcd_e2_toggle();
-
-    /* output low nibble */
-    LCD_DATA0_PORT = dataBits | (data&0x0F);
-    lcd_e2_toggle();
+    lcd_write_e(data, rs, 0);
+}
 
-    /* all data pins high (inactive) */
-    LCD_DATA0_PORT = dataBits | 0x0F;
+static void lcd_write2(uint8_t data,uint8_t rs)
+{
+    lcd_write_e(data, rs, 1);
 }
 
 /*************************************************************************
 Low-level function to read byte from LCD controller
 Input:    rs     1: read data    
                  0: read busy flag / address counter
+          e2     1: second controller (E2)
 Returns:  byte read from LCD controller
 *************************************************************************/
-static uint8_t lcd_read(uint8_t rs) 
+static uint8_t lcd_read_e(uint8_t rs,uint8_t e2) 
 {
     uint8_t data;
     
@@ -249,17 +285,17 @@ static uint8_t lcd_read(uint8_t rs)
     {
         DDR(LCD_DATA0_PORT) &= 0xF0;         /* configure data pins as input */
         
-        lcd_e_high();
+        lcd_ex_high(e2);
         lcd_e_delay();        
         data = PIN(LCD_DATA0_PORT) << 4;     /* read high nibble first */
-        lcd_e_low();
+        lcd_ex_low(e2);
         
         lcd_e_delay();                       /* Enable 500ns low       */
         
-        lcd_e_high();
+        lcd_ex_high(e2);
         lcd_e_delay();
         data |= PIN(LCD_DATA0_PORT)&0x0F;    /* read low nibble        */
-        lcd_e_low();
+        lcd_ex_low(e2);
     }
     else
     {
@@ -270,55 +306,39 @@ static uint8_t lcd_read(uint8_t rs)
         DDR(LCD_DATA3_PORT) &= ~_BV(LCD_DATA3_PIN);
                 
         /* read high nibble first */
-        lcd_e_high();
+        lcd_ex_high(e2);
         lcd_e_delay();        
         data = 0;
         if ( PIN(LCD_DATA0_PORT) & _BV(LCD_DATA0_PIN) ) data |= 0x10;
         if ( PIN(LCD_DATA1_PORT) & _BV(LCD_DATA1_PIN) ) data |= 0x20;
         if ( PIN(LCD_DATA2_PORT) & _BV(LCD_DATA2_PIN) ) data |= 0x40;
         if ( PIN(LCD_DATA3_PORT) & _BV(LCD_DATA3_PIN) ) data |= 0x80;
-        lcd_e_low();
+        lcd_ex_low(e2);
 
         lcd_e_delay();                       /* Enable 500ns low       */
     
         /* read low nibble */    
-        lcd_e_high();
+        lcd_ex_high(e2);
         lcd_e_delay();
         if ( PIN(LCD_DATA0_PORT) & _BV(LCD_DATA0_PIN) ) data |= 0x01;
         if ( PIN(LCD_DATA1_PORT) & _BV(LCD_DATA1_PIN) ) data |= 0x02;
         if ( PIN(LCD_DATA2_PORT) & _BV(LCD_DATA2_PIN) ) data |= 0x04;
         if ( PIN(LCD_DATA3_PORT) & _BV(LCD_DATA3_PIN) ) data |= 0x08;        
-        lcd_e_low();
+        lcd_ex_low(e2);
     }
+    if (rs)
+        lcd_state[e2].written = 0;   /* a read loads the next address */
     return data;
 }
 
-static uint8_t lcd_read2(uint8_t rs) 
+static uint8_t lcd_read(uint8_t rs)
 {
-    uint8_t data;
-    
-    if (rs)
-        lcd_rs_high();                       /* RS=1: read data      */
-    else
-        lcd_rs_low();                        /* RS=0: read busy flag */
-    lcd_rw_high();                           /* RW=1  read mode      */
-    
+    return lcd_read_e(rs, 0);
+}
 
-	DDR(LCD_DATA0_PORT) &= 0xF0;         /* configure data pins as input */
-	
-	lcd_e2_high();
-	lcd_e_delay();        
-	data = PIN(LCD_DATA0_PORT) << 4;     /* read high nibble first */
-	lcd_e2_low();
-	
-	lcd_e_delay();                       /* Enable 500ns low       */
-	
-	lcd_e2_high();
-	lcd_e_delay();
-	data |= PIN(LCD_DATA0_PORT)&0x0F;    /* read low nibble        */
-	lcd_e2_low();
-    
-    return data;
+static uint8_t lcd_read2(uint8_t rs)
+{
+    return lcd_read_e(rs, 1);
 }
 
 /*************************************************************************
@@ -356,23 +376,185 @@ static uint8_t lcd_waitbusy2(void)
 
 /* lcd_waitbusy */
 
+/*************************************************************************
+Forget everything known about the controller state
+*************************************************************************/
+static void lcd_state_reset(struct lcdState *s)
+{
+    s->function       = LCD_STATE_UNKNOWN;
+    s->entrymode      = LCD_STATE_UNKNOWN;
+    s->displaycontrol = LCD_STATE_UNKNOWN;
+    s->cgram          = 0;
+    s->ks0073_4lines  = 0;
+    s->written        = 1;
+}
+
+
+/*************************************************************************
+Check an instruction against the cached controller state
+Input:    s    state of the controller the instruction is sent to
+          cmd  instruction about to be sent
+          pos  current address counter as returned by lcd_waitbusy(),
+               LCD_STATE_UNKNOWN if it has not been read
+Returns:  1 if the instruction would not change anything and can be dropped,
+          0 if it has to be sent (the cache is updated accordingly)
+*************************************************************************/
+static uint8_t lcd_elide(struct lcdState *s, uint8_t cmd, uint8_t pos)
+{
+    if (cmd & (1<<LCD_DDRAM))
+    {
+        /* address counter already points at this DDRAM address. After a data
+           write a read returns valid data only once the address is set. */
+        if ( !s->cgram && !s->written && pos == (cmd & ~(1<<LCD_DDRAM)) )
+            return 1;
+        s->cgram = 0;
+    }
+    else if (cmd & (1<<LCD_CGRAM))
+    {
+        s->cgram = 1;
+    }
+    else if (cmd & (1<<LCD_FUNCTION))
+    {
+        if (cmd == s->function)
+            return 1;
+        s->function = cmd;
+    }
+    else if (s->function & KS0073_RE)
+    {
+        /* KS0073 extended instruction set, only the 4 lines mode is tracked */
+        if ( (cmd & 0xF8) == (1<<LCD_ON) )
+            s->ks0073_4lines = (cmd & KS0073_NW) ? 1 : 0;
+    }
+    else if (cmd & (1<<LCD_MOVE))
+    {
+        ; /* cursor/display shift always has an effect */
+    }
+    else if (cmd & (1<<LCD_ON))
+    {
+        if (cmd == s->displaycontrol)
+            return 1;
+        s->displaycontrol = cmd;
+    }
+    else if (cmd & (1<<LCD_ENTRY_MODE))
+    {
+        if (cmd == s->entrymode)
+            return 1;
+        s->entrymode = cmd;
+    }
+    else if (cmd & (1<<LCD_HOME))
+    {
+        s->cgram = 0;
+    }
+    else if (cmd & (1<<LCD_CLR))
+    {
+        /* clear display also sets the entry mode to increment */
+        s->cgram = 0;
+        s->entrymode |= (1<<LCD_ENTRY_INC);
+    }
+    return 0;
+}/* lcd_elide */
+
+
 /*************************************************************************
 Send LCD controller instruction command
+Instructions that would not change the controller state are dropped.
 Input:   instruction to send to LCD controller, see HD44780 data sheet
 Returns: none
 *************************************************************************/
 void lcd_command(uint8_t cmd)
 {
-    lcd_waitbusy();
+    uint8_t pos;
+
+    pos = lcd_waitbusy();
+    if ( lcd_elide(&lcd_state[0], cmd, pos) )
+        return;
     lcd_write(cmd,0);
 }
 
 void lcd_command2(uint8_t cmd)
 {
-    lcd_waitbusy2();
+    uint8_t pos;
+
+    pos = lcd_waitbusy2();
+    if ( lcd_elide(&lcd_state[1], cmd, pos) )
+        return;
     lcd_write2(cmd,0);
 }
 
+/*************************************************************************
+Write instruction to the second controller without waiting for it, used
+when it is not known whether a second controller is fitted
+*************************************************************************/
+static void lcd_command2_nowait(uint8_t cmd)
+{
+    lcd_elide(&lcd_state[1], cmd, LCD_STATE_UNKNOWN);  /* keep cache in step */
+    lcd_write2(cmd,0);
+}
+
+
+/*************************************************************************
+Enable 4 lines mode of the KS0073 controller, unless already done
+*************************************************************************/
+static void lcd_ks0073_4lines(void)
+{
+    if (lcd_state[0].ks0073_4lines)
+        return;
+
+    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
+    lcd_command(KS0073_4LINES_MODE);
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
+}
+
+
+/*************************************************************************
+Build the segment table for lcd_lines x lcd_disp_length and put the first
+controller into the matching line mode:
+  one line           0x00 (80 characters)
+  one split line     0x00, 0x40 (16x1 panels wired as 8x2)
+  two lines          0x00, 0x40
+  four lines         0x00, 0x40, then lines 3 and 4 continue lines 1 and 2
+  four lines KS0073  0x00, 0x20, 0x40, 0x60
+  40x4               0x00, 0x40 on each controller
+*************************************************************************/
+static void lcd_geometry(void)
+{
+    uint8_t *start = lcd_geom.start;
+    uint8_t line, base, col, i;
+    uint8_t ks0073 = lcd_lines > 2 && lcd_controller_ks0073 && !mode.enable;
+
+    lcd_geom.split = lcd_lines == 1 && lcd_split_line;
+    lcd_geom.count = lcd_lines << lcd_geom.split;
+    lcd_geom.second = mode.enable ? 0x0C : 0;
+    lcd_geom.cursor = 0;
+    lcd_span_length = lcd_disp_length >> lcd_geom.split;
+    line = ks0073 ? 0x80 : LCD_DDRAM_LINE(lcd_geom.count);
+
+    start[0] = 0x00;
+    start[1] = ks0073 ? 0x20 : 0x40;
+    start[2] = ks0073 ? 0x40 : mode.enable ? 0x00 : lcd_span_length;
+    start[3] = ks0073 ? 0x60 : mode.enable ? 0x40 : 0x40 + lcd_span_length;
+
+    /* the address counter runs on from the end of a DDRAM line (40 characters,
+       80 in one line mode, the KS0073 counts through) to the start of the next */
+    for (i = 0; i < lcd_geom.count; i++) {
+        base = line == 40 ? start[i] & 0x40 : 0;
+        col = start[i] - base + lcd_span_length;
+        if (col >= line) {
+            col -= line;
+            base ^= line == 40 ? 0x40 : 0;
+        }
+        lcd_geom.end[i] = base + col;
+    }
+
+    if (ks0073)
+        lcd_ks0073_4lines();
+    else if (lcd_geom.count == 1)
+        lcd_command(LCD_FUNCTION_4BIT_1LINE);
+    else
+        lcd_command(LCD_FUNCTION_4BIT_2LINES);
+}
+
 /*************************************************************************
 Send data byte to LCD controller 
 Input:   data to send to LCD controller, see HD44780 data sheet
@@ -391,88 +573,90 @@ void lcd_data2(uint8_t data)
 }
 
 
+
+
+
+/*
+** PUBLIC FUNCTIONS 
+*/
+
+/*************************************************************************
+Show the cursor on the first (0) or second (1) controller of a 4x40 display,
+text goes to that controller from now on
+*************************************************************************/
+static void lcd_select(uint8_t second)
+{
+	mode.display = second;
+	if (second) {
+		lcd_command(displaycontrol);
+		lcd_command2(active_displaycontrol);
+	} else {
+		lcd_command(active_displaycontrol);
+		lcd_command2(displaycontrol);
+	}
+}
+
+
+/*************************************************************************
+Segment of the display the DDRAM address <pos> of the controller the cursor
+is on is in, the address after the last character of a segment counts as in
+it. The segment the cursor was put into last is tried first: it settles the
+addresses that two segments share, like the start of line 3 of a HD44780
+that follows the end of line 1.
+*************************************************************************/
+static uint8_t lcd_segment(uint8_t pos)
+{
+    uint8_t i = lcd_geom.cursor;
+    uint8_t best = LCD_SEGMENTS;
+
+    if ( lcd_segment_active(i)
+      && ((uint8_t)(pos - lcd_geom.start[i]) < lcd_span_length || pos == lcd_geom.end[i]) )
+        return i;
+
+    /* off the visible part: the nearest segment starting before pos */
+    for (i = 0; i < lcd_geom.count; i++) {
+        if ( !lcd_segment_active(i) )
+            continue;
+        if ( (uint8_t)(pos - lcd_geom.start[i]) < lcd_span_length )
+            return i;
+        if ( best == LCD_SEGMENTS
+          || (uint8_t)(pos - lcd_geom.start[i]) < (uint8_t)(pos - lcd_geom.start[best]) )
+            best = i;
+    }
+    return best == LCD_SEGMENTS ? 0 : best;
+}
+
+
+/*************************************************************************
+Put the cursor into segment <i> at column <x> of the segment
+*************************************************************************/
+static void lcd_segment_goto(uint8_t i, uint8_t x)
+{
+    lcd_geom.cursor = i;
+    if (mode.enable)
+        lcd_select((lcd_geom.second >> i) & 1);
+    if (lcd_second_active())
+        lcd_command2((1<<LCD_DDRAM)+lcd_geom.start[i]+x);
+    else
+        lcd_command((1<<LCD_DDRAM)+lcd_geom.start[i]+x);
+}
+
+
 /*************************************************************************
 Move cursor to the start of next line or to the first line if the cursor 
 is already on the last line.
 *************************************************************************/
 static inline void lcd_newline(uint8_t pos)
 {
-    register uint8_t addressCounter;
+    uint8_t i = lcd_segment(pos) | lcd_geom.split;  /* last segment of the line */
+
+    if (++i >= lcd_geom.count)
+        i = 0;
+    lcd_segment_goto(i, 0);
 
-    if (mode.enable)
-    {
-    	if( mode.display == 0)
-    	{
-    		if ( pos < (LCD_START_LINE2) )
-    			addressCounter = LCD_START_LINE2;
-    		else
-    		{
-    			addressCounter = LCD_START_LINE1;
-    			mode.display = 1;
-    			lcd_command(displaycontrol);
-    			lcd_command2(active_displaycontrol);
-    		}
-    	}
-    	else
-    	{
-    		if ( pos < (LCD_START_LINE2) )
-    			addressCounter = LCD_START_LINE2;
-    		else
-    		{
-    			addressCounter = LCD_START_LINE1;
-    			mode.display = 0;
-    			lcd_command(active_displaycontrol);
-    			lcd_command2(displaycontrol);
-    		}
-    	}
-    	if (mode.display == 0)
-    		lcd_command((1<<LCD_DDRAM)+addressCounter);
-    	else
-    		lcd_command2((1<<LCD_DDRAM)+addressCounter);
-    }
-    else 
-    {
-    	if (lcd_lines == 1)
-    		addressCounter = 0;
-		else if (lcd_lines == 4)
-		{
-			if (lcd_controller_ks0073)
-			{
-				if ( pos < LCD_START_LINE2 )
-					addressCounter = LCD_START_LINE2;
-				else if ( (pos >= LCD_START_LINE2) && (pos < LCD_START_LINE3) )
-					addressCounter = LCD_START_LINE3;
-				else if ( (pos >= LCD_START_LINE3) && (pos < LCD_START_LINE4) )
-					addressCounter = LCD_START_LINE4;
-				else 
-					addressCounter = LCD_START_LINE1;
-			} else {
-				if ( pos < LCD_START_LINE3 )
-					addressCounter = LCD_START_LINE2;
-				else if ( (pos >= LCD_START_LINE2) && (pos < LCD_START_LINE4) )
-					addressCounter = LCD_START_LINE3;
-				else if ( (pos >= LCD_START_LINE3) && (pos < LCD_START_LINE2) )
-					addressCounter = LCD_START_LINE4;
-				else 
-					addressCounter = LCD_START_LINE1;
-			}
-		}
-		else // lcd_lines == 2
-		{
-			if ( pos < (LCD_START_LINE2) )
-				addressCounter = LCD_START_LINE2;
-			else
-				addressCounter = LCD_START_LINE1;
-		}
-		lcd_command((1<<LCD_DDRAM)+addressCounter);
-    }
 }/* lcd_newline */
 
 
-/*
-** PUBLIC FUNCTIONS 
-*/
-
 /*************************************************************************
 Set cursor to specified position
 Input:    x  horizontal position  (0: left most position)
@@ -481,60 +665,33 @@ Returns:  none
 *************************************************************************/
 void lcd_gotoxy(uint8_t x, uint8_t y)
 {
-	if (mode.enable == 1)
-	{
-		if ( y==0 )
-		{
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-			mode.display = 0;
-			lcd_command(active_displaycontrol);
-			lcd_command2(displaycontrol);
-		}
-		else if ( y==1)
-		{
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-			mode.display = 0;
-			lcd_command(active_displaycontrol);
-			lcd_command2(displaycontrol);
-		}
-		else if ( y==2)
-		{
-			lcd_command2((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-			mode.display = 1;
-			lcd_command(displaycontrol);
-			lcd_command2(active_displaycontrol);
-		}
-		else /* y==3 */
-		{
-			lcd_command2((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-			mode.display = 1;
-			lcd_command(displaycontrol);
-			lcd_command2(active_displaycontrol);
-		}
-	}
-	else if (lcd_lines == 1)
-		lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-	else if (lcd_lines == 4)
-	{
-		if ( y==0 )
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-		else if ( y==1)
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-		else if ( y==2)
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE3+x);
-		else /* y==3 */
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE4+x);
-	}
-	else // lcd_lines == 2
-	{
-		if ( y==0 ) 
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-		else
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
+	uint8_t i;
+
+	if (y >= lcd_lines)
+		y = lcd_lines - 1;
+	i = y << lcd_geom.split;
+	if (lcd_geom.split && x >= lcd_span_length) {
+		x -= lcd_span_length;
+		i++;
 	}
+	lcd_segment_goto(i, x);
 }/* lcd_gotoxy */
 
 
+/*************************************************************************
+Set the cursor for reading: the address is set even when the address counter
+is already there, after a data write the controller needs that to read
+valid data
+*************************************************************************/
+void lcd_seek(uint8_t x, uint8_t y)
+{
+    /* keeps lcd_elide() from dropping the address set */
+    lcd_state[0].written = 1;
+    lcd_state[1].written = 1;
+    lcd_gotoxy(x, y);
+}
+
+
 /*************************************************************************
 *************************************************************************/
 int lcd_getxy(void)
@@ -543,6 +700,139 @@ int lcd_getxy(void)
 }
 
 
+/*************************************************************************
+Line and column of the cursor, on the controller it is on
+*************************************************************************/
+uint8_t lcd_where(uint8_t *x)
+{
+    uint8_t pos = lcd_second_active() ? lcd_waitbusy2() : lcd_waitbusy();
+    uint8_t i = lcd_segment(pos);
+
+    *x = pos - lcd_geom.start[i];
+    if (i & lcd_geom.split)
+        *x += lcd_span_length;
+    return i >> lcd_geom.split;
+}
+
+
+/*************************************************************************
+Fill columns x..x1 of lines y..y1 with a character, with one address set
+per line. The cursor stays where it is.
+*************************************************************************/
+void lcd_fill(uint8_t x, uint8_t y, uint8_t x1, uint8_t y1, char c)
+{
+    uint8_t cx, cy, i;
+
+    cy = lcd_where(&cx);
+    if (x1 >= lcd_disp_length)
+        x1 = lcd_disp_length - 1;
+    if (y1 >= lcd_lines)
+        y1 = lcd_lines - 1;
+
+    for (; y <= y1; y++) {
+        lcd_gotoxy(x, y);
+        for (i = x; i <= x1; i++) {
+            if (i == lcd_span_length && lcd_geom.split)
+                lcd_gotoxy(i, y);
+            lcd_putraw(c);
+        }
+    }
+    lcd_gotoxy(cx, cy);
+}
+
+
+/*************************************************************************
+Clear from the cursor to the end of the line or of the screen, the cursor
+stays where it is
+*************************************************************************/
+void lcd_clreol(void)
+{
+    uint8_t x, y;
+
+    y = lcd_where(&x);
+    lcd_fill(x, y, 0xff, y, ' ');
+}
+
+void lcd_clreos(void)
+{
+    uint8_t x, y;
+
+    y = lcd_where(&x);
+    lcd_fill(0, y + 1, 0xff, 0xff, ' ');
+    lcd_fill(x, y, 0xff, y, ' ');
+}
+
+
+/*************************************************************************
+Display character code at current cursor position, without interpreting
+control characters or wrapping lines
+*************************************************************************/
+void lcd_putraw(uint8_t c)
+{
+    if(mode.enable && mode.display == 1)
+        lcd_data2(c);
+    else
+        lcd_data(c);
+}
+
+
+/*************************************************************************
+Read the character at the current cursor position, the cursor advances
+the same way as after writing one
+*************************************************************************/
+uint8_t lcd_getc(void)
+{
+    if(mode.enable && mode.display == 1) {
+        lcd_waitbusy2();
+        return lcd_read2(1);
+    }
+    lcd_waitbusy();
+    return lcd_read(1);
+}
+
+
+/*************************************************************************
+Which of the custom characters 0-7 are on the screen, as a bit mask. The
+cursor stays where it is on both controllers.
+*************************************************************************/
+uint8_t lcd_cgram_visible(void)
+{
+    uint8_t ac = lcd_waitbusy();
+    uint8_t ac2 = mode.enable ? lcd_waitbusy2() : 0;
+    uint8_t mask = 0;
+    uint8_t i, x, c, second;
+
+    /* set the address before reading */
+    lcd_state[0].written = 1;
+    lcd_state[1].written = 1;
+    for (i = 0; i < lcd_geom.count; i++) {
+        /* with two controllers each one has two lines */
+        second = (lcd_geom.second >> i) & 1;
+        if (second)
+            lcd_command2((1<<LCD_DDRAM)+lcd_geom.start[i]);
+        else
+            lcd_command((1<<LCD_DDRAM)+lcd_geom.start[i]);
+
+        for (x = 0; x < lcd_span_length; x++) {
+            if (second) {
+                lcd_waitbusy2();
+                c = lcd_read2(1);
+            } else {
+                lcd_waitbusy();
+                c = lcd_read(1);
+            }
+            if (c < 8)
+                mask |= _BV(c);
+        }
+    }
+
+    lcd_command((1<<LCD_DDRAM)+ac);
+    if (mode.enable)
+        lcd_command2((1<<LCD_DDRAM)+ac2);
+    return mask;
+}
+
+
 /*************************************************************************
 Clear display and set cursor to home position
 *************************************************************************/
@@ -550,7 +840,7 @@ void lcd_clrscr(void)
 {
     lcd_command(1<<LCD_CLR);
     if(mode.enable)
-        lcd_write2(1<<LCD_CLR,0);
+        lcd_command2_nowait(1<<LCD_CLR);
     mode.display = 0;
 	lcd_command(active_displaycontrol);
 	lcd_command2(displaycontrol);
@@ -592,57 +882,23 @@ void lcd_putc(char c)
     }
     else
     {
-    	if (lcd_wrap_lines == 1)
+    	if (lcd_wrap_lines || lcd_geom.split)
     	{
-    		if (mode.enable)
-    		{
-    			if( mode.display == 0)
-    			{
-        			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-        				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE2,0);    
-        			}else if ( pos == LCD_START_LINE2+lcd_disp_length ){
-        				lcd_write2((1<<LCD_DDRAM)+LCD_START_LINE1,0);
-        				mode.display = 1;
-            			lcd_command(displaycontrol);
-            			lcd_command2(active_displaycontrol);
-        			}
-    			}
-    			else
-    			{
-        			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-        				lcd_write2((1<<LCD_DDRAM)+LCD_START_LINE2,0);    
-        			}else if ( pos == LCD_START_LINE2+lcd_disp_length ){
-        				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
-        				mode.display = 0;
-            			lcd_command(active_displaycontrol);
-            			lcd_command2(displaycontrol);
-        			}
-    			}
-    		}
-    		else if (lcd_lines == 1)
-    		{
-    			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
-    			}
-    		}
-    		else if (lcd_lines == 4)
-    		{
-    			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE2,0);    
-    			}else if ( pos == LCD_START_LINE2+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE3,0);
-    			}else if ( pos == LCD_START_LINE3+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE4,0);
-    			}else if ( pos == LCD_START_LINE4+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
-    			}
-    		}
-    		else // lcd_lines == 2
-    		{
-    			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE2,0);    
-    			}else if ( pos == LCD_START_LINE2+lcd_disp_length ){
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
+    		/* at the end of a segment: on to the next one, the second half
+    		   of a split line always follows the first */
+    		uint8_t i = lcd_segment(pos);
+
+    		if ( pos == lcd_geom.end[i] ) {
+    			if (++i >= lcd_geom.count)
+    				i = 0;
+    			if (lcd_wrap_lines || (i & lcd_geom.split)) {
+    				lcd_geom.cursor = i;
+    				if ( (lcd_geom.second >> i) & 1 )
+    					lcd_write2((1<<LCD_DDRAM)+lcd_geom.start[i],0);
+    				else
+    					lcd_write((1<<LCD_DDRAM)+lcd_geom.start[i],0);
+    				if (mode.enable && mode.display != ((lcd_geom.second >> i) & 1))
+    					lcd_select((lcd_geom.second >> i) & 1);
     			}
     		}
     		if(mode.enable && mode.display == 1)
@@ -742,38 +998,33 @@ void lcd_init(void)
     }
     delay(16000);        /* wait 16ms or more after power-on       */
     
-    /* initial write to lcd is 8bit */
+    /* initial write to lcd is 8bit, both controllers take the same reset sequence */
     LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);  // _BV(LCD_FUNCTION)>>4;
     LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);  // _BV(LCD_FUNCTION_8BIT)>>4;
     lcd_e_toggle();
+    lcd_e2_toggle();
     delay(4992);         /* delay, busy flag can't be checked here */
    
     /* repeat last command */ 
-    lcd_e_toggle();      
+    lcd_e_toggle();
+    lcd_e2_toggle();
     delay(64);           /* delay, busy flag can't be checked here */
     
     /* repeat last command a third time */
-    lcd_e_toggle();      
+    lcd_e_toggle();
+    lcd_e2_toggle();
     delay(64);           /* delay, busy flag can't be checked here */
 
     /* now configure for 4bit mode */
     LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);   // LCD_FUNCTION_4BIT_1LINE>>4
     lcd_e_toggle();
+    lcd_e2_toggle();
     delay(64);           /* some displays need this additional delay */
     
     /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */    
-
-	if (lcd_lines == 4 && lcd_controller_ks0073)
-	{
-		/* Display with KS0073 controller requires special commands for enabling 4 line mode */
-		lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-		lcd_command(KS0073_4LINES_MODE);
-		lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-	}
-	else if (lcd_lines == 1)
-		lcd_command(LCD_FUNCTION_4BIT_1LINE);      /* function set: display lines  */
-	else //lcd_lines == 2
-		lcd_command(LCD_FUNCTION_4BIT_2LINES);
+    lcd_state_reset(&lcd_state[0]);
+    lcd_state_reset(&lcd_state[1]);
+    lcd_geometry();                         /* function set: display lines  */
 
     lcd_command(LCD_DISP_OFF);              /* display off                  */
     lcd_clrscr();                           /* display clear                */ 
@@ -783,9 +1034,9 @@ void lcd_init(void)
     // Clear out the second display.
     // As we don't know if we have a second display we can not use lcd_command2
     delay(64);
-    lcd_write2(LCD_FUNCTION_4BIT_2LINES,0);
+    lcd_command2_nowait(LCD_FUNCTION_4BIT_2LINES);
     delay(64);
-    lcd_write2(LCD_DISP_OFF,0);		// Turn off dispaly2 in case we have one.
+    lcd_command2_nowait(LCD_DISP_OFF);		// Turn off dispaly2 in case we have one.
     delay(64);
 
 }/* lcd_init */
@@ -793,36 +1044,29 @@ void lcd_init(void)
 
 void lcd_setup(uint8_t col, uint8_t row)
 {
-	if (lcd_lines != row)
-	{
-		lcd_lines = row;
-		if (lcd_lines == 4 && lcd_controller_ks0073)
-		{
-		    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
-			lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-			lcd_command(KS0073_4LINES_MODE);
-			lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-		}
-		else if (lcd_lines == 1)
-		    lcd_command(LCD_FUNCTION_4BIT_1LINE);      /* function set: display lines  */
-		else // lcd_lines == 2
-			lcd_command(LCD_FUNCTION_4BIT_2LINES);
-	}
-	if (lcd_disp_length != col)
-		lcd_disp_length = col;
+	if (row == 0)
+		row = 1;
+	else if (row > LCD_SEGMENTS)
+		row = LCD_SEGMENTS;
+	lcd_lines = row;
+	lcd_disp_length = col;
 
 	if (lcd_lines == 4 && lcd_disp_length == 40)
 	{
-		mode.enable = 1;
-		mode.display = 0;
-		lcd_command2(LCD_FUNCTION_4BIT_2LINES);
-		lcd_command2(LCD_DISP_OFF);
-		lcd_clrscr(); 
-		lcd_command2(LCD_MODE_DEFAULT);
-		lcd_command2(LCD_DISPLAYCONTROL | LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF);
+		if (!mode.enable)
+		{
+			mode.enable = 1;
+			mode.display = 0;
+			lcd_command2(LCD_FUNCTION_4BIT_2LINES);
+			lcd_command2(LCD_DISP_OFF);
+			lcd_clrscr(); 
+			lcd_command2(LCD_MODE_DEFAULT);
+			lcd_command2(LCD_DISPLAYCONTROL | LCD_DISPLAYON | LCD_CURSOROFF | LCD_BLINKOFF);
+		}
 	}
 	else
 		mode.enable = 0;
+	lcd_geometry();
 }
 
 void lcd_linewrap(uint8_t on)
@@ -833,25 +1077,55 @@ void lcd_linewrap(uint8_t on)
 void lcd_ks0073(uint8_t on)
 {
 	lcd_controller_ks0073 = on;
-	if(on)
-	{
-		/* Display with KS0073 controller requires special commands for enabling 4 line mode */
-		lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-		lcd_command(KS0073_4LINES_MODE);
-		lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-	}
+	lcd_geometry();
+}
+
+void lcd_split(uint8_t on)
+{
+	lcd_split_line = on;
+	lcd_geometry();
 }
 
 void lcd_createCharacter(uint8_t pos, uint8_t *data)
 {
+	uint8_t ac = lcd_waitbusy();
+	uint8_t ac2 = mode.enable ? lcd_waitbusy2() : 0;
+
 	lcd_command(_BV(LCD_CGRAM) | (pos<<3)); // set CG RAM start address
-	lcd_write2(_BV(LCD_CGRAM) | (pos<<3), 0);
+	lcd_command2_nowait(_BV(LCD_CGRAM) | (pos<<3));
 
 	for(uint8_t i = 0; i < 8; i++) {
 		lcd_data(data[i]);
 		delay(10);
 		lcd_write2(data[i],1);
 	}
+
+	// back to the cursor of each controller
+	lcd_command(_BV(LCD_DDRAM) | ac);
+	if(mode.enable)
+		lcd_command2(_BV(LCD_DDRAM) | ac2);
+}
+
+void lcd_createCharacter_p(uint8_t pos, const uint8_t *progmem_data)
+{
+	uint8_t ac = lcd_waitbusy();
+	uint8_t ac2 = mode.enable ? lcd_waitbusy2() : 0;
+
+	// both controllers, as lcd_createCharacter(): the second one may be set up later
+	lcd_command(_BV(LCD_CGRAM) | (pos<<3));
+	lcd_command2_nowait(_BV(LCD_CGRAM) | (pos<<3));
+	for(uint8_t i = 0; i < 8; i++) {
+		uint8_t b = pgm_read_byte(progmem_data + i);
+
+		lcd_data(b);
+		delay(10);
+		lcd_write2(b,1);
+	}
+
+	// back to the cursor of each controller
+	lcd_command(_BV(LCD_DDRAM) | ac);
+	if(mode.enable)
+		lcd_command2(_BV(LCD_DDRAM) | ac2);
 }
 
 
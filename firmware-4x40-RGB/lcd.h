@@ -57,6 +57,7 @@
 #define LCD_START_LINE2  0x40     /**< DDRAM address of first char of line 2 */
 #define LCD_START_LINE3  0x14     /**< DDRAM address of first char of line 3 */
 #define LCD_START_LINE4  0x54     /**< DDRAM address of first char of line 4 */
+#define LCD_DDRAM_LINE(lines) ((lines) == 1 ? 80 : 40) /**< DDRAM characters per line */
 
 #define LCD_IO_MODE      1         /**< 0: memory mapped mode, 1: IO port mode */
 
@@ -73,7 +74,11 @@
  *  is possible to connect these data lines in different order or even on different
  *  ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
  *  
+ *  A board that has the LCD on other pins can also define LCD_PORT and all of
+ *  the lines below before this file is read (on the compiler command line or
+ *  in a header included first), the defaults are not used then.
  */
+#ifndef LCD_PORT
 #define LCD_PORT         PORTD        /**< port for the LCD lines   */
 #define LCD_DATA0_PORT   LCD_PORT     /**< port for 4bit data bit 0 */
 #define LCD_DATA1_PORT   LCD_PORT     /**< port for 4bit data bit 1 */
@@ -89,8 +94,14 @@
 #define LCD_RW_PIN       5            /**< pin  for RW line         */
 #define LCD_E_PORT       LCD_PORT     /**< port for Enable line     */
 #define LCD_E_PIN        6            /**< pin  for Enable line     */
+#ifdef FEATURE_UART
+#error "FEATURE_UART uses PD0/PD1 (RXD/TXD), which are LCD data lines here, define the LCD pins of the board"
+#endif
+#endif /* LCD_PORT */
+#ifndef LCD_E2_PORT
 #define LCD_E2_PORT      PORTB        /**< port for Enable2 line     */
 #define LCD_E2_PIN       0            /**< pin  for Enable2 line     */
+#endif
 
 /**
  *  @name Definitions for LCD command instructions
@@ -180,10 +191,30 @@
 */
 extern void lcd_init(void);
 
+extern uint8_t lcd_lines;
+extern uint8_t lcd_disp_length;
+
 extern void lcd_setup(uint8_t col, uint8_t row);
 extern void lcd_linewrap(uint8_t on);
 extern void lcd_ks0073(uint8_t on);
 
+
+/**
+ @brief    Geometry
+
+ lcd_setup(), lcd_ks0073() and lcd_split() build a table with the DDRAM
+ address each line starts at and the controller it is on, cursor positions
+ are looked up in it. Up to four lines, lines 3 and 4 of a HD44780 continue
+ lines 1 and 2 in DDRAM. A 40x4 display has two lines on each controller.
+
+ Panels with split addressing (16x1 wired as 8x2) are driven in two line mode,
+ the second half of the line follows the first at 0x40. lcd_putc() and
+ lcd_gotoxy() handle the split, lcd_putraw() and lcd_getc() do not: they run
+ through lcd_span_length characters from the start of a line or half line.
+*/
+extern uint8_t lcd_span_length;
+extern void lcd_split(uint8_t on);
+
 extern void lcd_displayon(uint8_t on);
 extern void lcd_blink(uint8_t on);
 extern void lcd_cursor(uint8_t on);
@@ -193,8 +224,12 @@ extern void lcd_scroll_left(void);
 
 extern void lcd_setmode(uint8_t displaymode);
 
+/* define character <pos>, the cursor stays where it is */
 extern void lcd_createCharacter(uint8_t pos, uint8_t *data);
 
+/* the same from program memory */
+extern void lcd_createCharacter_p(uint8_t pos, const uint8_t *progmem_data);
+
 /**
  @brief    Clear display and set cursor to home position
  @param    void                                        
@@ -211,6 +246,34 @@ extern void lcd_clrscr(void);
 extern void lcd_home(void);
 
 
+/**
+ @brief    Fill a rectangle with a character, the cursor stays where it is
+ @param    x  first column
+ @param    y  first line
+ @param    x1 last column, clipped to the display
+ @param    y1 last line, clipped to the display
+ @param    c  character code, control characters are not interpreted
+ @return   none
+*/
+extern void lcd_fill(uint8_t x, uint8_t y, uint8_t x1, uint8_t y1, char c);
+
+
+/**
+ @brief    Clear from the cursor to the end of the line, the cursor stays
+ @param    void
+ @return   none
+*/
+extern void lcd_clreol(void);
+
+
+/**
+ @brief    Clear from the cursor to the end of the screen, the cursor stays
+ @param    void
+ @return   none
+*/
+extern void lcd_clreos(void);
+
+
 /**
  @brief    Set cursor to specified position
  
@@ -221,6 +284,25 @@ extern void lcd_home(void);
 extern void lcd_gotoxy(uint8_t x, uint8_t y);
 
 
+/**
+ @brief    Set the cursor before reading with lcd_getc(): like lcd_gotoxy(),
+           but the address is set even when the cursor is already there,
+           the LCD returns stale data after a write until then
+ @param    x horizontal position\n (0: left most position)
+ @param    y vertical position\n   (0: first line)
+ @return   none
+*/
+extern void lcd_seek(uint8_t x, uint8_t y);
+
+
+/**
+ @brief    Find the cursor, lcd_gotoxy() takes it back there
+ @param    x the column is stored here
+ @return   line of the cursor
+*/
+extern uint8_t lcd_where(uint8_t *x);
+
+
 /**
  @brief    Display character at current cursor position
  @param    c character to be displayed                                       
@@ -248,6 +330,10 @@ extern void lcd_puts_p(const char *progmem_s);
 
 /**
  @brief    Send LCD controller instruction command
+
+ Instructions that would not change the state of the controller (e.g. setting
+ the display control or entry mode to the value it already has, or the DDRAM
+ address the cursor is already at) are dropped.
  @param    cmd instruction to send to LCD controller, see HD44780 data sheet
  @return   none
 */
@@ -264,6 +350,33 @@ extern void lcd_command(uint8_t cmd);
 extern void lcd_data(uint8_t data);
 
 
+/**
+ @brief    Display character code at current cursor position
+
+ Unlike lcd_putc(), control characters and line wrap are not interpreted
+ @param    c character code
+ @return   none
+*/
+extern void lcd_putraw(uint8_t c);
+
+
+/**
+ @brief    Read character code at current cursor position, the cursor
+           advances as after a write
+ @param    void
+ @return   character code, or data byte when the address is in CGRAM
+*/
+extern uint8_t lcd_getc(void);
+
+/**
+ @brief    Find the custom characters shown on the screen, the cursor stays
+           where it is
+ @param    void
+ @return   bit mask, bit n set when character n is on the screen
+*/
+extern uint8_t lcd_cgram_visible(void);
+
+
 /**
  @brief macros for automatically storing string constant in program memory
 */
@@ -0,0 +1,104 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_MACROS
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#include "macro.h"
+#include "frame.h"
+#include "input.h"
+
+#define MACRO_NONE  0xff
+
+// byte 0 of a slot is the length of the macro, the commands follow
+uint8_t EEMEM e_macros[MACRO_SLOTS][MACRO_SLOT_SIZE];
+
+static uint8_t recording = MACRO_NONE;
+static uint8_t record_length;       // MACRO_SLOT_SIZE when the recording overflowed
+static uint8_t replaying = MACRO_NONE;
+static uint8_t replay_position;
+static uint8_t replay_length;
+
+void macro_record(uint8_t slot)
+{
+	if (slot >= MACRO_SLOTS || replaying != MACRO_NONE)
+		return;
+
+	// empty until the recording is complete
+	eeprom_update_byte(&e_macros[slot][0], 0);
+	recording = slot;
+	record_length = 0;
+}
+
+void macro_stop(void)
+{
+	if (recording == MACRO_NONE)
+		return;
+
+	macro_unrecord(); // the stop command itself
+	if (record_length < MACRO_SLOT_SIZE)
+		eeprom_update_byte(&e_macros[recording][0], record_length);
+	recording = MACRO_NONE;
+}
+
+// Take back the last byte recorded, for bytes that are not commands
+void macro_unrecord(void)
+{
+	if (recording != MACRO_NONE && record_length && record_length < MACRO_SLOT_SIZE)
+		record_length--;
+}
+
+void macro_replay(uint8_t slot)
+{
+	if (slot >= MACRO_SLOTS || replaying != MACRO_NONE)
+		return; // macros do not nest
+
+	replay_length = eeprom_read_byte(&e_macros[slot][0]);
+	if (replay_length >= MACRO_SLOT_SIZE)
+		return; // erased EEPROM
+	replaying = slot;
+	replay_position = 0;
+}
+
+// Whether commands of a macro are left to execute
+bool macro_pending(void)
+{
+	if (replaying != MACRO_NONE && replay_position >= replay_length)
+		replaying = MACRO_NONE;
+	return replaying != MACRO_NONE;
+}
+
+// Next command byte, from the macro that is replayed or from the bus
+uint8_t macro_receiveByte(void)
+{
+	uint8_t b;
+
+	if (replaying != MACRO_NONE) {
+		if (replay_position < replay_length)
+			return eeprom_read_byte(&e_macros[replaying][++replay_position]);
+		return 0xff; // the command was cut off by the end of the macro
+	}
+
+	b = frame_receiveByte();
+	if (recording != MACRO_NONE && record_length < MACRO_SLOT_SIZE) {
+		if (++record_length < MACRO_SLOT_SIZE)
+			eeprom_update_byte(&e_macros[recording][record_length], b);
+	}
+	return b;
+}
+
+#endif // FEATURE_MACROS
@@ -0,0 +1,61 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Command macros (FEATURE_MACROS)
+ *
+ * A macro is a sequence of ordinary commands kept in EEPROM and replayed
+ * with a single byte:
+ *
+ *   0xe4 <slot>   record: the commands that follow are executed as usual
+ *                 and stored in the slot as well
+ *   0xe5          stop recording
+ *   0xc0-0xc3     replay slot 0-3
+ *
+ * A slot holds MACRO_SLOT_SIZE - 1 bytes. A recording that does not fit is
+ * thrown away and leaves the slot empty; so is one that was interrupted by
+ * a reset. Macros do not nest: replay and record commands inside a macro
+ * are ignored. Framed commands are recorded without their frame.
+ */
+
+#ifndef MACRO_H__
+#define MACRO_H__
+
+#ifdef FEATURE_MACROS
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#define MACRO_SLOTS     4
+#ifndef MACRO_BYTES
+#define MACRO_BYTES     96          /* EEPROM for all slots */
+#endif
+#define MACRO_SLOT_SIZE (MACRO_BYTES / MACRO_SLOTS)
+
+void macro_record(uint8_t slot);
+void macro_stop(void);
+void macro_unrecord(void);
+void macro_replay(uint8_t slot);
+bool macro_pending(void);
+uint8_t macro_receiveByte(void);
+
+#else
+
+#define macro_pending()         false
+#define macro_receiveByte()     frame_receiveByte()
+
+#endif // FEATURE_MACROS
+
+#endif // MACRO_H__
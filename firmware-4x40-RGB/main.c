@@ -23,13 +23,51 @@
 
 #include "lcd.h"
 #include "usiTwiSlave.h"
+#include "input.h"
 
 #include "max5160.h"
 #include "mcp4013.h"
-
-#define FIRMWARE_REVISION 5
+#include "frame.h"
+#include "regs.h"
+#include "snapshot.h"
+#include "macro.h"
+#include "utf8.h"
+#include "glyph.h"
+#include "window.h"
+#include "term.h"
+#include "ready.h"
+
+#define FIRMWARE_REVISION 6
 #define SLAVE_ADDRESS 50
 
+// Feature flags reported by command 0x8e
+#define CAP_GEOMETRY      0x0001  // 0xfd set columns/rows (Ver 2)
+#define CAP_BRIGHTNESS    0x0002  // 0xd2-0xd4 get contrast, set/get brightness (Ver 3)
+#define CAP_COLOR         0x0004  // 0xd5-0xd7 RGB backlight (Ver 4)
+#define CAP_SAFEMODE      0x0008  // brightness limited until 0xf0 disables safemode
+#define CAP_FLOW_CONTROL  0x0010  // the bus is held instead of dropping bytes (Ver 6)
+#define CAP_PROFILING     0x0020  // 0x8c/0x8d performance counters
+#define CAP_FRAMING       0x0040  // 0xf1/0xf2 framed commands (Ver 6)
+#define CAP_REGISTERS     0x0080  // 0xf5 register personality (Ver 6)
+#define CAP_SNAPSHOT      0x0200  // 0xe0-0xe2 snapshot shown at power up (Ver 6)
+#define CAP_MACROS        0x0400  // 0xe4/0xe5 record and 0xc0-0xc3 replay macros (Ver 6)
+#define CAP_UTF8          0x0800  // 0xe8/0xe9 UTF-8 text for the ROM code page (Ver 6)
+#define CAP_GLYPHS        0x1000  // 0xea/0xeb glyph bank loaded into CGRAM on use (Ver 6)
+#define CAP_WINDOWS       0x2000  // 0xb0-0xb3 text window with wrap and scroll (Ver 6)
+#define CAP_TERMINAL      0x4000  // 0xf4 VT100 terminal mode (Ver 6)
+#define CAP_UART          0x8000  // commands are also taken from the UART (Ver 6)
+
+#define CAP_REPLY_LENGTH  9
+
+#define READBACK_MAX      (TWI_TX_BUFFER_SIZE - 2)  // 0x8f reply, the count and the characters fill the transmit buffer
+
+// Text goes to the window when one is active
+#ifdef FEATURE_WINDOWS
+#define text_putc(c)      window_putc(c)
+#else
+#define text_putc(c)      lcd_putc(c)
+#endif
+
 #ifndef DEFAULT_BRIGHTNESS
 #define DEFAULT_BRIGHTNESS 100
 #endif // DEFAULT_BRIGHTNESS
@@ -109,6 +147,9 @@ void init(void)
 		stored_address = SLAVE_ADDRESS;
 	
 	usiTwiSlaveInit(stored_address);
+#ifdef FEATURE_UART
+	uart_init();
+#endif
 
 #ifdef FEATURE_SAFEMODE
 	uint8_t magic = eeprom_read_byte(&b_magic);
@@ -132,16 +173,146 @@ void init(void)
 	sei(); // enable interrupts 
 }
 
+/*
+ * Reply to command 0x8e. Hosts use this to pick the fastest way to drive the
+ * display instead of checking the firmware revision:
+ *
+ *   uint8   length of the reply, later revisions may append fields
+ *   uint16  CAP_ feature flags, little endian
+ *   uint8   number of bytes the receive buffer holds
+ *   uint8   longest write transaction that is safe to send, 0 for no limit
+ *   uint8   columns
+ *   uint8   rows
+ *   uint8   highest SCL frequency, in units of 100kHz
+ *   uint8   longest frame, 0 without framing
+ */
+void send_capabilities(void)
+{
+	uint16_t features = CAP_GEOMETRY | CAP_BRIGHTNESS | CAP_COLOR | CAP_FLOW_CONTROL;
+#ifdef FEATURE_SAFEMODE
+	features |= CAP_SAFEMODE;
+#endif
+#ifdef FEATURE_FRAMING
+	features |= CAP_FRAMING;
+#endif
+#ifdef FEATURE_REGISTERS
+	features |= CAP_REGISTERS;
+#endif
+#ifdef FEATURE_SNAPSHOT
+	features |= CAP_SNAPSHOT;
+#endif
+#ifdef FEATURE_MACROS
+	features |= CAP_MACROS;
+#endif
+#ifdef FEATURE_UTF8
+	features |= CAP_UTF8;
+#endif
+#ifdef FEATURE_GLYPHS
+	features |= CAP_GLYPHS;
+#endif
+#ifdef FEATURE_WINDOWS
+	features |= CAP_WINDOWS;
+#endif
+#ifdef FEATURE_TERMINAL
+	features |= CAP_TERMINAL;
+#endif
+#ifdef FEATURE_UART
+	features |= CAP_UART;
+#endif
+
+	input_transmitByte(CAP_REPLY_LENGTH);
+	input_transmitByte(features);
+	input_transmitByte(features >> 8);
+	input_transmitByte(TWI_RX_BUFFER_SIZE - 1);
+	input_transmitByte(0); // the bus is held while the receive buffer is full
+	input_transmitByte(lcd_disp_length);
+	input_transmitByte(lcd_lines);
+	input_transmitByte(4); // Fast-mode
+	input_transmitByte(FRAME_MAX);
+}
+
+// Reply with the number of characters and the character codes of up to <n>
+// columns of line <y> from column <x> on. The reply is clipped to the line
+// and to READBACK_MAX so it fits the transmit buffer. The cursor stays where
+// it is.
+void send_screen(uint8_t x, uint8_t y, uint8_t n)
+{
+	uint8_t cx, cy, i;
+
+	if (y >= lcd_lines || x >= lcd_disp_length)
+		n = 0;
+	else if (n > lcd_disp_length - x)
+		n = lcd_disp_length - x;
+	if (n > READBACK_MAX)
+		n = READBACK_MAX;
+	input_transmitByte(n);
+
+	cy = lcd_where(&cx);
+	for (i = 0; i < n; i++, x++) {
+		if (i == 0 || x == lcd_span_length)
+			lcd_seek(x, y); // a split line continues elsewhere in DDRAM
+		input_transmitByte(lcd_getc());
+	}
+	lcd_gotoxy(cx, cy);
+}
+
+#ifdef FEATURE_SNAPSHOT
+void save_snapshot(void)
+{
+	uint8_t backlight[SNAPSHOT_BACKLIGHTS] = { OCR0A, OCR1A, OCR1B };
+
+	snapshot_save(backlight);
+}
+
+// Paint the snapshot saved with 0xe0, returns false when there is none
+bool restore_snapshot(void)
+{
+	uint8_t backlight[SNAPSHOT_BACKLIGHTS];
+
+	if (!snapshot_restore(backlight))
+		return false;
+#ifdef FEATURE_SAFEMODE
+	if(safemode && backlight[0] > MAX_SAFE_BRIGHTNESS)
+		backlight[0] = MAX_SAFE_BRIGHTNESS;
+#endif // FEATURE_SAFEMODE
+	OCR0A = backlight[0];
+	OCR1A = backlight[1];
+	OCR1B = backlight[2];
+	return true;
+}
+#endif // FEATURE_SNAPSHOT
+
+#ifdef FEATURE_TERMINAL
+// Cursor shape asked for by the terminal
+void term_cursor(uint8_t flags)
+{
+	lcd_cursor(flags & TERM_CURSOR);
+	lcd_blink(flags & TERM_BLINK);
+}
+#endif // FEATURE_TERMINAL
+
 void processTWI( void )
 {
 	uint8_t b,c,d;
 	uint8_t tmp_data[8];
 
-	b = usiTwiReceiveByte();
+#ifdef FEATURE_FRAMING
+	bool replayed = macro_pending();
+#endif
+
+	b = macro_receiveByte();
+#ifdef FEATURE_FRAMING
+	if (!replayed && !frame_accept(b))
+		return; // dropped while looking for the next frame
+#endif
+#ifdef FEATURE_WINDOWS
+	if (b >= 0x80 && b != 0xa2 && b != 0xa4)
+		window_moved(); // the command may move the cursor
+#endif
 	
 	switch (b) {
 		case 0x80: // save brightness
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 #ifdef FEATURE_SAFEMODE
 			if(safemode && c > MAX_SAFE_BRIGHTNESS)
 				c = MAX_SAFE_BRIGHTNESS;
@@ -151,7 +322,7 @@ void processTWI( void )
 			break;
 #ifdef FEATURE_CHANGE_TWI_ADDRESS
 		case 0x81: // set slave address
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 			if(c < 128) // Address is 7 bit
 			{
 				eeprom_update_byte(&b_slave_address, c);
@@ -165,21 +336,21 @@ void processTWI( void )
 		case 0x83: // set scroll mode
 			break;
 		case 0x84: // receive segment data
-			c = usiTwiReceiveByte(); // segment data
+			c = macro_receiveByte(); // segment data
 			break;
 		case 0x85: // set dots (the four bits of the second byte controls dots individually)
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 			break;
 /*#ifdef FEATURE_SET_TIME
 		case 0x87: // display time (hh:mm with seconds controlling middle dot)
-			//set_time(usiTwiReceiveByte(), usiTwiReceiveByte(), usiTwiReceiveByte());
+			//set_time(macro_receiveByte(), macro_receiveByte(), macro_receiveByte());
 			break;
 #endif // FEATURE_SET_TIME*/
 		case 0x88: // display integer
 			{
 				/*
-				uint8_t i1 = usiTwiReceiveByte();
-				uint8_t i2 = usiTwiReceiveByte();
+				uint8_t i1 = macro_receiveByte();
+				uint8_t i2 = macro_receiveByte();
 
 				uint16_t i = (i2 << 8) + i1;
 				set_number(i);
@@ -187,14 +358,27 @@ void processTWI( void )
 			}
 			break;
 		case 0x89: // set position (only valid for ROTATE mode)
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 			lcd_gotoxy(c,0);
 			break;
 		case 0x8a: // get firmware revision
-			usiTwiTransmitByte(FIRMWARE_REVISION);
+			input_transmitByte(FIRMWARE_REVISION);
 			break;
 		case 0x8b: // get number of digits
-			usiTwiTransmitByte(16);
+			input_transmitByte(lcd_disp_length);
+			break;
+		case 0x8e: // get capabilities (Ver 6)
+			send_capabilities();
+			break;
+		case 0x86: // get cursor position: column, line (Ver 6)
+			d = lcd_where(&c);
+			input_transmitByte(c);
+			input_transmitByte(d);
+			break;
+		case 0x8f: // read screen: line, column, count, replies with count and characters (Ver 6)
+			d = macro_receiveByte();
+			c = macro_receiveByte();
+			send_screen(c, d, macro_receiveByte());
 			break;
 		case 0x90: // Show address
 			break;
@@ -204,8 +388,8 @@ void processTWI( void )
 			break;
 		case 0x92:
 		case 0xa1: // gotoxy
-			c = usiTwiReceiveByte();
-			d = usiTwiReceiveByte();
+			c = macro_receiveByte();
+			d = macro_receiveByte();
 			lcd_gotoxy(c,d);
 			break;
 		/* Low level commands */
@@ -249,11 +433,14 @@ void processTWI( void )
 			displaymode &= ~LCD_ENTRYSHIFTINCREMENT;
 			lcd_setmode(displaymode);
 			break;
-		case 0x9f: // create custom character
-			c = usiTwiReceiveByte() & 0x7; // locations are from 0~7
+		case 0x9f: // create custom character, the cursor stays where it is (Ver 6)
+			c = macro_receiveByte() & 0x7; // locations are from 0~7
+#ifdef FEATURE_GLYPHS
+			glyph_pin(c);
+#endif
 
 			for(uint8_t i = 0; i < 8; i++) {
-				tmp_data[i] = usiTwiReceiveByte();
+				tmp_data[i] = macro_receiveByte();
 			}
 			
 			lcd_createCharacter(c, tmp_data);
@@ -262,35 +449,70 @@ void processTWI( void )
 		/* LCD commands */
 		
 		case 0xa2: // putc
-			c = usiTwiReceiveByte();
-			lcd_putc(c);
+			c = macro_receiveByte();
+			text_putc(c);
 			break;
 		case 0xa3: // command
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 			lcd_command(c);
 			break;
 		case 0xa4: // Character
-			c = usiTwiReceiveByte();
-			lcd_putc(c);
+			c = macro_receiveByte();
+			text_putc(c);
 			break;
 		case 0xa5: // Send raw data
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 			lcd_data(c);
 			break;
+		case 0xa8: // fill rectangle: lines (first << 4 | last), first column, last column, character (Ver 6)
+			{
+				uint8_t lines = macro_receiveByte();
+				uint8_t x = macro_receiveByte();
+				uint8_t x1 = macro_receiveByte();
+
+				lcd_fill(x, lines >> 4, x1, lines & 0x0f, macro_receiveByte());
+			}
+			break;
+		case 0xa9: // clear to end of line (Ver 6)
+			lcd_clreol();
+			break;
+		case 0xaa: // clear to end of screen (Ver 6)
+			lcd_clreos();
+			break;
+#ifdef FEATURE_WINDOWS
+		case 0xb0: // text window: lines (first << 4 | last), first column, last column, mode, see window.h (Ver 6)
+			{
+				uint8_t lines = macro_receiveByte();
+				uint8_t x = macro_receiveByte();
+				uint8_t x1 = macro_receiveByte();
+
+				window_set(lines, x, x1, macro_receiveByte());
+			}
+			break;
+		case 0xb1: // leave window (Ver 6)
+			window_leave();
+			break;
+		case 0xb2: // back to the window (Ver 6)
+			window_enter();
+			break;
+		case 0xb3: // clear window (Ver 6)
+			window_clear();
+			break;
+#endif // FEATURE_WINDOWS
 		case 0xd0: // Save new contrast
-			currentcontrast = usiTwiReceiveByte();
+			currentcontrast = macro_receiveByte();
 			mcp4013_set(currentcontrast);
 			eeprom_write_byte(&b_contrast, currentcontrast);
 			break;
 		case 0xd1: // Set new contrast
-			currentcontrast = usiTwiReceiveByte();		
+			currentcontrast = macro_receiveByte();		
 			mcp4013_set(currentcontrast);
 			break;
 		case 0xd2: // Get contrast (Ver 3)
-			usiTwiTransmitByte(currentcontrast);
+			input_transmitByte(currentcontrast);
 			break;
 		case 0xd3: // Set new brightness (Ver 3)
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 #ifdef FEATURE_SAFEMODE
 			if(safemode && c > MAX_SAFE_BRIGHTNESS)
 				OCR0A = MAX_SAFE_BRIGHTNESS;
@@ -299,41 +521,41 @@ void processTWI( void )
 				OCR0A = c;
 			break;
 		case 0xd4: // Get brightness (Ver 3)
-			usiTwiTransmitByte(OCR0A);
+			input_transmitByte(OCR0A);
 			break;
 		case 0xd5: // Save new RGB (Ver 4)
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 #ifdef FEATURE_SAFEMODE
 			if(safemode && c > MAX_SAFE_BRIGHTNESS)
 				OCR0A = MAX_SAFE_BRIGHTNESS;
 			else
 #endif // FEATURE_SAFEMODE
 				OCR0A = c;
-			OCR1A = usiTwiReceiveByte();
-			OCR1B = usiTwiReceiveByte();
+			OCR1A = macro_receiveByte();
+			OCR1B = macro_receiveByte();
 			eeprom_write_byte(&b_brightness[0], OCR0A);
 			eeprom_write_byte(&b_brightness[1], OCR1A);
 			eeprom_write_byte(&b_brightness[2], OCR1B);
 			break;
 		case 0xd6: // Set new RGB (Ver 4)
-			c = usiTwiReceiveByte();
+			c = macro_receiveByte();
 #ifdef FEATURE_SAFEMODE
 			if(safemode && c > MAX_SAFE_BRIGHTNESS)
 				OCR0A = MAX_SAFE_BRIGHTNESS;
 			else
 #endif // FEATURE_SAFEMODE
 				OCR0A = c;
-			OCR1A = usiTwiReceiveByte();
-			OCR1B = usiTwiReceiveByte();
+			OCR1A = macro_receiveByte();
+			OCR1B = macro_receiveByte();
 			break;
 		case 0xd7: // Get RGB (Ver 4);
-			usiTwiTransmitByte(OCR0A);
-			usiTwiTransmitByte(OCR1A);
-			usiTwiTransmitByte(OCR1B);
+			input_transmitByte(OCR0A);
+			input_transmitByte(OCR1A);
+			input_transmitByte(OCR1B);
 			break;
 		case 0xf0: // Go out/in of safemode (Ver 4)
-			c = usiTwiReceiveByte();
-			d = usiTwiReceiveByte();
+			c = macro_receiveByte();
+			d = macro_receiveByte();
 #ifdef FEATURE_SAFEMODE
 			if ( c == 0xAF && d == 0x0F) // Disable safemode
 			{
@@ -347,17 +569,97 @@ void processTWI( void )
 			}
 #endif // FEATURE_SAFEMODE
 			break;
+#ifdef FEATURE_MACROS
+		case 0xc0: // replay macro 0-3, see macro.h (Ver 6)
+		case 0xc1:
+		case 0xc2:
+		case 0xc3:
+			macro_replay(b - 0xc0);
+			break;
+#endif // FEATURE_MACROS
+#ifdef FEATURE_SNAPSHOT
+		case 0xe0: // save snapshot, painted at power up, see snapshot.h (Ver 6)
+			save_snapshot();
+			break;
+		case 0xe1: // paint snapshot (Ver 6)
+			restore_snapshot();
+			break;
+		case 0xe2: // delete snapshot (Ver 6)
+			snapshot_erase();
+			break;
+#endif // FEATURE_SNAPSHOT
+#ifdef FEATURE_MACROS
+		case 0xe4: // record macro (Ver 6)
+			macro_record(macro_receiveByte());
+			break;
+		case 0xe5: // stop recording (Ver 6)
+			macro_stop();
+			break;
+#endif // FEATURE_MACROS
+#ifdef FEATURE_UTF8
+		case 0xe8: // select character ROM for UTF-8 text, see utf8.h (Ver 6)
+			utf8_rom(macro_receiveByte());
+			break;
+		case 0xe9: // UTF-8 text (Ver 6)
+			c = macro_receiveByte();
+			while (c--)
+				utf8_putc(macro_receiveByte());
+			break;
+#endif // FEATURE_UTF8
+#ifdef FEATURE_GLYPHS
+		case 0xea: // show glyph from the bank, see glyph.h (Ver 6)
+			glyph_show(macro_receiveByte());
+			break;
+		case 0xeb: // give the CGRAM slots back to the bank (Ver 6)
+			glyph_release();
+			break;
+#endif // FEATURE_GLYPHS
+#ifdef FEATURE_FRAMING
+		case 0xf1: // framed mode on/off (Ver 6)
+			frame_mode(macro_receiveByte());
+			break;
+		case 0xf2: // frame, see frame.h (Ver 6)
+#ifdef FEATURE_MACROS
+			macro_unrecord(); // the commands in the frame are recorded
+#endif
+			frame_receive();
+			break;
+#endif // FEATURE_FRAMING
+#ifdef FEATURE_TERMINAL
+		case 0xf4: // terminal mode on/off, see term.h (Ver 6)
+			term_mode(macro_receiveByte());
+			break;
+#endif // FEATURE_TERMINAL
+#ifdef FEATURE_REGISTERS
+		case 0xf5: // register personality until 0 is written to register 0xf0, see regs.h (Ver 6)
+			regs_run();
+			break;
+#endif // FEATURE_REGISTERS
+		case 0xfa: // split addressing on/off, for 16x1 panels wired as 8x2 (Ver 6)
+			lcd_split(macro_receiveByte());
+			break;
 		case 0xfb: // Set line wrap
-			lcd_linewrap(usiTwiReceiveByte());
+			lcd_linewrap(macro_receiveByte());
 			break;
 		case 0xfc: // Set KS0073 controller
-			lcd_ks0073(usiTwiReceiveByte());
+			lcd_ks0073(macro_receiveByte());
 			break;
 		case 0xfd: // Set row/col
-			lcd_setup(usiTwiReceiveByte(),usiTwiReceiveByte());
+			c = macro_receiveByte(); // the order of evaluation of arguments is unspecified
+			d = macro_receiveByte();
+			lcd_setup(c, d);
 			break;
 		case 0xfe: // reset to known state
 			flushTwiBuffers();
+#ifdef FEATURE_TERMINAL
+			term_mode(0);
+#endif
+#ifdef FEATURE_WINDOWS
+			window_reset();
+#endif
+#ifdef FEATURE_UTF8
+			utf8_reset();
+#endif
 			lcd_clrscr();
 			backlight_init();
 			mcp4013_set(eeprom_read_byte(&b_contrast));
@@ -366,9 +668,12 @@ void processTWI( void )
 			break;
 		default:
 			if (b >= 0x80) break; // anything above 0x80 is considered a reserved command and is ignored
+#ifdef FEATURE_TERMINAL
+			else if (term_active()) term_putc(b);
+#endif
 			else if (b == (uint8_t)'\r') break; // Don't really care about carrier returns
-			else if (b >= 0 && b <= 9) lcd_putc(b + '0');
-			else lcd_putc(b);
+			else if (b >= 0 && b <= 9) text_putc(b + '0');
+			else text_putc(b);
 			break;
 	}
 }
@@ -396,12 +701,18 @@ void main(void)
     }
 #endif
     
+#ifdef FEATURE_SNAPSHOT
+	bool restored = restore_snapshot();
+#else
+	bool restored = false;
+#endif // FEATURE_SNAPSHOT
+
 #ifdef FEATURE_SHOW_ADDRESS_ON_STARTUP
 	uint8_t counter = 0;
 	
 #define MAX_COUNTER	200
 
-	while(!usiTwiDataInReceiveBuffer() && counter <= MAX_COUNTER)
+	while(!restored && !input_available() && counter <= MAX_COUNTER)
 	{
 		counter++;
 		_delay_ms(10);
@@ -421,8 +732,16 @@ void main(void)
 #endif //FEATURE_SHOW_ADDRESS_ON_STARTUP
 	
 	while (1) {
-		while (usiTwiDataInReceiveBuffer())	{ // process I2C command
+		// the end of a frame or macro is only noticed by *_pending(), ask them first
+		while (macro_pending() || frame_pending() || input_select())	{ // process a command
 			processTWI();
+#ifdef FEATURE_READY
+			ready_update();
+#endif
 		}
+#ifdef FEATURE_READY
+		ready_update(); // also tells the host that the display is up
+#endif
+		USI_TWI_WAIT();
 	}
 }
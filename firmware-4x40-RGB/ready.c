@@ -0,0 +1,41 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_READY
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+
+#include "ready.h"
+#include "input.h"
+#include "frame.h"
+#include "macro.h"
+
+// Called after each command and when there is nothing left to do. The
+// level is checked with interrupts off, so a byte that arrives in between
+// is not overruled.
+void ready_update(void)
+{
+	if (macro_pending() || frame_pending() || !eeprom_is_ready())
+		return;
+
+	cli();
+	if (input_level() <= READY_LOW_WATER)
+		ready_assert();
+	sei();
+}
+
+#endif // FEATURE_READY
@@ -0,0 +1,60 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Register personality (FEATURE_REGISTERS)
+ *
+ * Command 0xf5 turns the display into a register file addressed like an I2C
+ * EEPROM. The first byte of each write transaction sets the register pointer
+ * and the bytes after it are written from there on; a read returns the
+ * registers from the pointer on. The pointer advances with every byte and is
+ * kept between transactions, so a span of the screen is updated with one
+ * write and checked with a write of the pointer and a repeated start read.
+ *
+ *   0x00-0x9f  screen, row by row in the geometry set with 0xfd:
+ *              register = row * columns + column
+ *   0xa0-0xdf  character generator RAM, 8 rows for each of the characters
+ *              0-7. A character is loaded when its last row is written, so
+ *              write all 8 rows of it.
+ *   0xf0       control: write 0 to return to commands, reads 1
+ *   0xf1       columns (read only)
+ *   0xf2       rows (read only)
+ *
+ * Other registers ignore writes and read 0xff, as does the LCD memory when
+ * the firmware is built with LCD_WRITE_ONLY. Each byte read is fetched from
+ * the LCD while the master waits (clock stretching). The pointer is set by
+ * the first write transaction after 0xf5, replies still queued at that time
+ * are read first. Leaving puts the cursor at the home position.
+ */
+
+#ifndef REGS_H__
+#define REGS_H__
+
+#ifdef FEATURE_REGISTERS
+
+#include <avr/io.h>
+
+#define REGS_SCREEN     0x00
+#define REGS_CGRAM      0xa0
+#define REGS_CGRAM_END  0xe0
+#define REGS_CONTROL    0xf0
+#define REGS_COLUMNS    0xf1
+#define REGS_ROWS       0xf2
+
+void regs_run(void);
+
+#endif // FEATURE_REGISTERS
+
+#endif // REGS_H__
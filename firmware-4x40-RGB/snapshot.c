@@ -0,0 +1,111 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_SNAPSHOT
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+
+#include "snapshot.h"
+#include "lcd.h"
+
+#define SNAPSHOT_VALID  0x5a        // neither the erased (0xff) nor the .eep (0x00) value
+
+struct snapshot {
+	uint8_t valid;
+	uint8_t cols;
+	uint8_t rows;
+	uint8_t backlight[SNAPSHOT_BACKLIGHTS];
+	uint8_t cgram[64];
+	uint8_t screen[SNAPSHOT_SCREEN];
+};
+
+struct snapshot EEMEM e_snapshot;
+
+void snapshot_save(const uint8_t *backlight)
+{
+	uint8_t *p;
+	uint8_t i, x, y;
+
+	if (lcd_disp_length * lcd_lines > SNAPSHOT_SCREEN)
+		return;
+
+	// invalid while it is being written, a reset in between leaves none
+	eeprom_update_byte(&e_snapshot.valid, 0xff);
+	eeprom_update_byte(&e_snapshot.cols, lcd_disp_length);
+	eeprom_update_byte(&e_snapshot.rows, lcd_lines);
+	for (i = 0; i < SNAPSHOT_BACKLIGHTS; i++)
+		eeprom_update_byte(&e_snapshot.backlight[i], backlight[i]);
+
+	lcd_gotoxy(0, 0); // CGRAM of the first controller of a 4x40 display
+	lcd_command(_BV(LCD_CGRAM));
+	for (i = 0; i < 64; i++)
+		eeprom_update_byte(&e_snapshot.cgram[i], lcd_getc());
+
+	p = e_snapshot.screen;
+	for (y = 0; y < lcd_lines; y++) {
+		for (x = 0; x < lcd_disp_length; x++) {
+			if (x == 0 || x == lcd_span_length)
+				lcd_seek(x, y); // a split line continues elsewhere in DDRAM
+			eeprom_update_byte(p++, lcd_getc());
+		}
+	}
+
+	lcd_gotoxy(0, 0);
+	eeprom_update_byte(&e_snapshot.valid, SNAPSHOT_VALID);
+}
+
+// Paint the stored snapshot, returns false when there is none
+bool snapshot_restore(uint8_t *backlight)
+{
+	uint8_t glyph[8];
+	uint8_t *p;
+	uint8_t cols, rows, i, x, y;
+
+	if (eeprom_read_byte(&e_snapshot.valid) != SNAPSHOT_VALID)
+		return false;
+
+	cols = eeprom_read_byte(&e_snapshot.cols);
+	rows = eeprom_read_byte(&e_snapshot.rows);
+	if (cols == 0 || cols * rows > SNAPSHOT_SCREEN)
+		return false;
+
+	lcd_setup(cols, rows);
+	eeprom_read_block(backlight, e_snapshot.backlight, SNAPSHOT_BACKLIGHTS);
+
+	for (i = 0; i < 8; i++) {
+		eeprom_read_block(glyph, &e_snapshot.cgram[i * 8], 8);
+		lcd_createCharacter(i, glyph);
+	}
+
+	p = e_snapshot.screen;
+	for (y = 0; y < rows; y++) {
+		for (x = 0; x < cols; x++) {
+			if (x == 0 || x == lcd_span_length)
+				lcd_gotoxy(x, y);
+			lcd_putraw(eeprom_read_byte(p++));
+		}
+	}
+
+	lcd_gotoxy(0, 0);
+	return true;
+}
+
+void snapshot_erase(void)
+{
+	eeprom_update_byte(&e_snapshot.valid, 0xff);
+}
+
+#endif // FEATURE_SNAPSHOT
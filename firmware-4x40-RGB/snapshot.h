@@ -0,0 +1,57 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Display snapshots (FEATURE_SNAPSHOT)
+ *
+ * Command 0xe0 stores the screen contents, the eight user characters, the
+ * geometry and the backlight in EEPROM, and the firmware paints them at
+ * power up instead of waiting for the host (and instead of showing the
+ * slave address). 0xe1 paints the stored snapshot right away, 0xe2 deletes
+ * it. The cursor is at the home position after 0xe0 and 0xe1.
+ *
+ * Only bytes that changed are programmed, but the first snapshot of a 20x4
+ * display still takes about half a second (a 40x4 one close to a second),
+ * during which the bus is held.
+ * Hosts should wait for that, as after the other commands that save to
+ * EEPROM. The screen is read back from the LCD, so FEATURE_SNAPSHOT needs
+ * the RW line (not LCD_WRITE_ONLY). Screens larger than SNAPSHOT_SCREEN
+ * characters are not saved.
+ */
+
+#ifndef SNAPSHOT_H__
+#define SNAPSHOT_H__
+
+#ifdef FEATURE_SNAPSHOT
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#ifdef LCD_WRITE_ONLY
+#error "FEATURE_SNAPSHOT reads the screen from the LCD, it does not work with LCD_WRITE_ONLY"
+#endif
+
+#define SNAPSHOT_BACKLIGHTS 3       /* brightness, or red, green and blue */
+#ifndef SNAPSHOT_SCREEN
+#define SNAPSHOT_SCREEN     160     /* up to 40x4 characters */
+#endif
+
+void snapshot_save(const uint8_t *backlight);
+bool snapshot_restore(uint8_t *backlight);
+void snapshot_erase(void);
+
+#endif // FEATURE_SNAPSHOT
+
+#endif // SNAPSHOT_H__
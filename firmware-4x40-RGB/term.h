@@ -0,0 +1,65 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Terminal mode (FEATURE_TERMINAL)
+ *
+ * Command 0xf4 <mode> turns terminal mode on (1) or off (0). In terminal
+ * mode text is taken as the output of a VT100 style terminal, on a window
+ * (see window.h) that covers the screen:
+ *
+ *   CR, LF, BS, TAB  column 0, new line (scrolls at the bottom), back, next
+ *                    multiple of 8
+ *   ESC 7, ESC 8     save, restore cursor
+ *   ESC c            clear screen, cursor to the top left
+ *   CSI r;c H, f     cursor to line r, column c (from 1)
+ *   CSI n A/B/C/D    cursor up/down/right/left
+ *   CSI n K          clear to the end (0), start (1) or all (2) of the line
+ *   CSI n J          clear to the end (0), start (1) or all (2) of the screen
+ *   CSI s, CSI u     save, restore cursor
+ *   CSI n m          SGR 5 turns a blinking block cursor on, 0 and 25 off
+ *   CSI ?25 h/l      show/hide the underline cursor
+ *
+ * Other control characters and sequences are ignored. Bytes from 0x80 up
+ * are still commands, so 0xf4 0 leaves terminal mode.
+ */
+
+#ifndef TERM_H__
+#define TERM_H__
+
+#ifdef FEATURE_TERMINAL
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#ifndef FEATURE_WINDOWS
+#error "FEATURE_TERMINAL needs FEATURE_WINDOWS"
+#endif
+
+#define TERM_PARAMS     2           /* parameters kept of a CSI sequence */
+
+#define TERM_CURSOR     0x01        /* cursor shape for term_cursor() */
+#define TERM_BLINK      0x02
+
+void term_mode(uint8_t on);
+bool term_active(void);
+void term_putc(char c);
+
+/* provided by main.c: set the cursor shape, TERM_ flags */
+void term_cursor(uint8_t flags);
+
+#endif // FEATURE_TERMINAL
+
+#endif // TERM_H__
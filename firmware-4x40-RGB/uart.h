@@ -0,0 +1,73 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * UART transport (FEATURE_UART)
+ *
+ * The USART takes the same command stream as I2C, 8N1 at UART_BAUD with
+ * double speed (250000 baud is exact at 8MHz). Received bytes go to a
+ * ring of UART_RX_BUFFER_SIZE bytes by interrupt. Replies to commands that
+ * came in on the UART are sent on TXD.
+ *
+ * Both transports work at the same time. A command is read from the
+ * transport its first byte came from, so commands never mix, and when
+ * both have data they take turns. The register personality (0xf5) is I2C
+ * only.
+ *
+ * There is no flow control: bytes that arrive while the ring is full are
+ * dropped. Slow commands such as clearing the screen (1.5ms,
+ * 37 bytes at 250000 baud) need a pause after them.
+ *
+ * RXD and TXD are PD0 and PD1, which carry LCD data lines on the Akafugu
+ * boards. The option is for boards that have the LCD on other pins, see
+ * the pin definitions in lcd.h; with the default pins the build stops with
+ * an error.
+ */
+
+#ifndef UART_H__
+#define UART_H__
+
+#ifdef FEATURE_UART
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#ifndef UART_BAUD
+#define UART_BAUD               250000
+#endif
+#define UART_UBRR               ((F_CPU + UART_BAUD * 4) / (UART_BAUD * 8) - 1)
+
+#define UART_RX_BUFFER_SIZE     32
+#define UART_RX_BUFFER_MASK     (UART_RX_BUFFER_SIZE - 1)
+
+#if (UART_RX_BUFFER_SIZE & UART_RX_BUFFER_MASK)
+#error "UART_RX_BUFFER_SIZE must be a power of 2"
+#endif
+
+// called while waiting for a byte; does nothing on the target, the host
+// simulator uses it to deliver the next bus and UART events
+#ifndef UART_WAIT
+#define UART_WAIT()
+#endif
+
+void uart_init(void);
+bool uart_available(void);
+uint8_t uart_level(void);
+uint8_t uart_receiveByte(void);
+void uart_transmitByte(uint8_t data);
+
+#endif // FEATURE_UART
+
+#endif // UART_H__
@@ -0,0 +1,99 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_FRAMING
+
+#include <avr/io.h>
+
+#include "frame.h"
+#include "input.h"
+
+static bool framed;                 // answer frames, drop bytes outside of them
+static bool executing;              // commands are taken from the frame
+static uint8_t frame[FRAME_MAX];
+static uint8_t frame_length;
+static uint8_t frame_position;
+
+uint8_t frame_crc8(uint8_t crc, uint8_t data)
+{
+	uint8_t i;
+
+	crc ^= data;
+	for (i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (crc << 1) ^ FRAME_CRC_POLY : crc << 1;
+	return crc;
+}
+
+void frame_mode(uint8_t on)
+{
+	framed = on;
+}
+
+// Whether a command byte fetched by processTWI() is to be executed
+bool frame_accept(uint8_t b)
+{
+	return executing || !framed || b == 0xf1 || b == 0xf2;
+}
+
+// Receive the rest of a frame after its start marker. A good frame is
+// executed by the following calls of processTWI().
+void frame_receive(void)
+{
+	uint8_t length, crc, i, c;
+
+	if (executing)
+		return; // frames do not nest
+
+	length = input_receiveByte();
+	crc = frame_crc8(0, length);
+	for (i = 0; i < length; i++) {
+		c = input_receiveByte();
+		crc = frame_crc8(crc, c);
+		if (i < FRAME_MAX)
+			frame[i] = c;
+	}
+
+	if (input_receiveByte() != crc || length == 0 || length > FRAME_MAX) {
+		if (framed)
+			input_transmitByte(FRAME_NAK);
+		return;
+	}
+
+	if (framed)
+		input_transmitByte(FRAME_ACK);
+	frame_length = length;
+	frame_position = 0;
+	executing = true;
+}
+
+// Whether commands of a frame are left to execute
+bool frame_pending(void)
+{
+	if (executing && frame_position >= frame_length)
+		executing = false;
+	return executing;
+}
+
+// Next command byte, from the frame that is executing or from the bus
+uint8_t frame_receiveByte(void)
+{
+	if (!executing)
+		return input_receiveByte();
+	if (frame_position < frame_length)
+		return frame[frame_position++];
+	return 0xff; // the command was cut off by the end of the frame
+}
+
+#endif // FEATURE_FRAMING
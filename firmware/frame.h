@@ -0,0 +1,69 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Framed commands (FEATURE_FRAMING)
+ *
+ * A frame carries a sequence of ordinary commands and is only executed when
+ * it arrived intact:
+ *
+ *   0xf2 <length> <length bytes of commands> <crc>
+ *
+ * The CRC-8 (polynomial 0x07, initial value 0) covers the length and the
+ * commands. Frames of 1 to FRAME_MAX bytes are accepted, they do not nest
+ * and a command must not be cut off by the end of its frame.
+ *
+ * Command 0xf1 <mode> turns framed mode on (1) or off (0). In framed mode
+ *  - every frame is answered with one status byte, FRAME_ACK when it is
+ *    executed or FRAME_NAK when it was corrupted and dropped. The status is
+ *    queued before the replies of the commands in the frame, so the host
+ *    reads it first. A read that returns 0xff means no frame was seen.
+ *  - bytes outside frames are dropped, apart from 0xf1 and 0xf2, so the
+ *    parser resynchronizes at the next frame after a byte got lost.
+ * Outside framed mode frames are executed the same way but not answered.
+ */
+
+#ifndef FRAME_H__
+#define FRAME_H__
+
+#ifdef FEATURE_FRAMING
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#define FRAME_MAX       32          /* longest frame */
+#define FRAME_CRC_POLY  0x07
+
+#define FRAME_ACK       0x06
+#define FRAME_NAK       0x15
+
+uint8_t frame_crc8(uint8_t crc, uint8_t data);
+
+void frame_mode(uint8_t on);
+bool frame_accept(uint8_t b);
+void frame_receive(void);
+bool frame_pending(void);
+uint8_t frame_receiveByte(void);
+
+#else
+
+#define FRAME_MAX       0
+
+#define frame_pending()         false
+#define frame_receiveByte()     input_receiveByte()
+
+#endif // FEATURE_FRAMING
+
+#endif // FRAME_H__
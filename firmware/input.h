@@ -0,0 +1,52 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Command input shared by the transports
+ *
+ * With FEATURE_UART input_select() picks the transport of the next command
+ * and input_receiveByte()/input_transmitByte() use it until the next
+ * input_select(). Without it they are the I2C functions.
+ * input_level() counts the bytes waiting on both, for FEATURE_READY.
+ */
+
+#ifndef INPUT_H__
+#define INPUT_H__
+
+#include "usiTwiSlave.h"
+#include "uart.h"
+
+#ifdef FEATURE_UART
+
+extern bool input_uart;
+
+bool input_select(void);
+
+#define input_available()       (usiTwiDataInReceiveBuffer() || uart_available())
+#define input_level()           (usiTwiAmountDataInReceiveBuffer() + uart_level())
+#define input_receiveByte()     (input_uart ? uart_receiveByte() : usiTwiReceiveByte())
+#define input_transmitByte(b)   do { if (input_uart) uart_transmitByte(b); else usiTwiTransmitByte(b); } while (0)
+
+#else
+
+#define input_select()          usiTwiDataInReceiveBuffer()
+#define input_available()       usiTwiDataInReceiveBuffer()
+#define input_level()           usiTwiAmountDataInReceiveBuffer()
+#define input_receiveByte()     usiTwiReceiveByte()
+#define input_transmitByte(b)   usiTwiTransmitByte(b)
+
+#endif // FEATURE_UART
+
+#endif // INPUT_H__
@@ -15,7 +15,8 @@
        added 4-bit I/O mode, improved and optimized code.
 
        Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in 
-       4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
+       IO port mode (LCD_IO_MODE=1) with a 4-bit or 8-bit (LCD_8BIT_MODE)
+       data bus.
        
        Memory mapped mode compatible with Kanda STK200, but supports also
        generation of R/W signal through A8 address line.
@@ -27,7 +28,9 @@
 #include <inttypes.h>
 #include <avr/io.h>
 #include <avr/pgmspace.h>
+#include <util/delay_basic.h>
 #include "lcd.h"
+#include "profile.h"
 
 /* 
 ** constants/macros 
@@ -36,23 +39,84 @@
 #define PIN(x) (*(&x - 2))    /* address of input register of port x          */
 
 
+#ifndef lcd_e_delay
 #define lcd_e_delay()   __asm__ __volatile__( "rjmp 1f\n 1:" );
+#endif
 #define lcd_e_high()    LCD_E_PORT  |=  _BV(LCD_E_PIN);
 #define lcd_e_low()     LCD_E_PORT  &= ~_BV(LCD_E_PIN);
 #define lcd_e_toggle()  toggle_e()
+#if LCD_RW_USED
 #define lcd_rw_high()   LCD_RW_PORT |=  _BV(LCD_RW_PIN)
 #define lcd_rw_low()    LCD_RW_PORT &= ~_BV(LCD_RW_PIN)
+#else
+#define lcd_rw_high()                /* RW tied low, pin not used */
+#define lcd_rw_low()
+#endif
 #define lcd_rs_high()   LCD_RS_PORT |=  _BV(LCD_RS_PIN)
 #define lcd_rs_low()    LCD_RS_PORT &= ~_BV(LCD_RS_PIN)
 
+#if LCD_DATA_BITS == 8
+/* all eight data lines are bit 0..7 of the same port */
+#define lcd_data_on_one_port() \
+    ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT ) \
+   && ( &LCD_DATA3_PORT == &LCD_DATA4_PORT) && ( &LCD_DATA4_PORT == &LCD_DATA5_PORT ) && ( &LCD_DATA5_PORT == &LCD_DATA6_PORT ) \
+   && ( &LCD_DATA6_PORT == &LCD_DATA7_PORT) \
+   && (LCD_DATA0_PIN == 0) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) \
+   && (LCD_DATA4_PIN == 4) && (LCD_DATA5_PIN == 5) && (LCD_DATA6_PIN == 6) && (LCD_DATA7_PIN == 7) )
+#endif
+
 uint8_t lcd_lines = 2;              /**< number of visible lines of the display */
 uint8_t lcd_disp_length = 16;       /**< visibles characters per line of the display */
 uint8_t lcd_controller_ks0073 = 0;  /**< Use 0 for HD44780 controller, 1 for KS0073 controller */
 uint8_t lcd_wrap_lines = 0;         /**< 0: no wrap, 1: wrap at end of visibile line */
+uint8_t lcd_split_line = 0;         /**< 1: one line panel addressed as two half lines (16x1) */
+uint8_t lcd_span_length = 16;       /**< characters of a line that follow each other in DDRAM */
+
+#ifdef FEATURE_PAGES
+static uint8_t lcd_page_base = 0;   /**< DDRAM column of the page that is written */
+static uint8_t lcd_page_shift = 0;  /**< display shift in columns, selects the page shown */
+#else
+#define lcd_page_base 0
+#endif
+
+#define KS0073_EXTENDED_FUNCTION_REGISTER_ON  (LCD_FUNCTION_SET_1LINE|KS0073_RE) /* extension-bit RE = 1 */
+#define KS0073_EXTENDED_FUNCTION_REGISTER_OFF LCD_FUNCTION_SET_1LINE  /* extension-bit RE = 0 */
+#define KS0073_4LINES_MODE                    0x09   /* |0|000|1001 4 lines mode */
+#define KS0073_RE                             0x04   /* function set: extension-bit RE */
+#define KS0073_NW                             0x01   /* extended function set: 4 lines mode */
+
+/*
+** controller state cache: the last value written to each instruction register,
+** used to drop instructions that would not change the state of the controller
+*/
+#define LCD_STATE_UNKNOWN 0xFF
+
+struct lcdState {
+	uint8_t function;         /**< last function set instruction */
+	uint8_t entrymode;        /**< last entry mode set instruction */
+	uint8_t displaycontrol;   /**< last display on/off control instruction */
+	uint8_t cgram:1;          /**< 1: address counter points into CG RAM */
+	uint8_t ks0073_4lines:1;  /**< 1: KS0073 4 lines mode is enabled */
+	uint8_t written:1;        /**< 1: data written, or display cleared, since the last address set or data read */
+};
+
+static struct lcdState lcd_state;
+
+/*
+** display geometry, built by lcd_setup(): the DDRAM address each segment of
+** the display starts at. A line is one segment, or two with split addressing.
+*/
+#define LCD_SEGMENTS 4
 
-#define KS0073_EXTENDED_FUNCTION_REGISTER_ON  0x24   /* |0|010|0100 4-bit mode extension-bit RE = 1 */
-#define KS0073_EXTENDED_FUNCTION_REGISTER_OFF 0x20   /* |0|000|1001 4 lines mode */
-#define KS0073_4LINES_MODE                    0x09   /* |0|001|0000 4-bit mode, extension-bit RE = 0 */
+struct lcdGeometry {
+	uint8_t start[LCD_SEGMENTS]; /**< DDRAM address of the first character of each segment */
+	uint8_t end[LCD_SEGMENTS];   /**< address counter after the last character of each segment */
+	uint8_t count;            /**< segments in use */
+	uint8_t split;            /**< 1: two segments per line */
+	uint8_t cursor;           /**< segment the cursor was put into last */
+};
+
+static struct lcdGeometry lcd_geom = { { 0x00, 0x40 }, { 0x10, 0x50 }, 2, 0, 0 };
 
 
 /* 
@@ -71,15 +135,8 @@ static void toggle_e(void);
 *************************************************************************/
 static inline void _delayFourCycles(unsigned int __count)
 {
-    if ( __count == 0 )    
-        __asm__ __volatile__( "rjmp 1f\n 1:" );    // 2 cycles
-    else
-        __asm__ __volatile__ (
-    	    "1: sbiw %0,1" "\n\t"                  
-    	    "brne 1b"                              // 4 cycles/loop
-    	    : "=w" (__count)
-    	    : "0" (__count)
-    	   );
+    if ( __count )                         // a count of 0 would loop 65536 times
+        _delay_loop_2(__count);            // 4 cycles/loop
 }
 
 
@@ -87,7 +144,7 @@ static inline void _delayFourCycles(unsigned int __count)
 delay for a minimum of <us> microseconds
 the number of loops is calculated at compile-time from MCU clock frequency
 *************************************************************************/
-#define delay(us)  _delayFourCycles( ( ( 1*(F_CPU/4000) )*us)/1000 )
+#define delay(us)  _delayFourCycles( ( ( 1*(F_CPU/4000) )*(us))/1000 )
 
 /* toggle Enable Pin to initiate write */
 static void toggle_e(void)
@@ -98,6 +155,103 @@ static void toggle_e(void)
 }
 
 
+#ifdef LCD_WRITE_ONLY
+/*
+** write-only mode: instruction timing and software address counter
+*/
+#define LCD_TIMING_CLEAR    0
+#define LCD_TIMING_HOME     1
+#define LCD_TIMING_COMMAND  2
+#define LCD_TIMING_DATA     3
+
+#define LCD_AC_CGRAM        0x01     /* address counter points into CGRAM */
+#define LCD_AC_DEC          0x02     /* entry mode decrements the address */
+
+/* delay loop counts for <us> microseconds, as used by delay() */
+#define LCD_DELAY_COUNT(us) ( ( ( 1*(F_CPU/4000) )*(us))/1000 )
+
+static uint16_t lcd_timing[4] = {
+    LCD_DELAY_COUNT(LCD_DELAY_CLEAR_US),
+    LCD_DELAY_COUNT(LCD_DELAY_HOME_US),
+    LCD_DELAY_COUNT(LCD_DELAY_COMMAND_US),
+    LCD_DELAY_COUNT(LCD_DELAY_DATA_US)
+};
+static uint16_t lcd_pending;         /* delay owed to the last instruction */
+static uint8_t  lcd_ac;              /* software copy of the address counter */
+static uint8_t  lcd_ac_flags;
+
+
+/*************************************************************************
+Step the software address counter by one the way the controller does,
+wrapping around within CGRAM or the DDRAM lines
+*************************************************************************/
+static void lcd_ac_step(uint8_t dec)
+{
+    if (dec)
+        lcd_ac--;
+    else
+        lcd_ac++;
+
+    if (lcd_ac_flags & LCD_AC_CGRAM)
+        lcd_ac &= 0x3F;
+    else if (lcd_state.function & (1<<LCD_FUNCTION_2LINES)) {
+        /* two line DDRAM: 0x00-0x27 and 0x40-0x67 */
+        if (lcd_ac == 0x28) lcd_ac = 0x40;
+        else if (lcd_ac == 0x68) lcd_ac = 0x00;
+        else if (lcd_ac == 0x3F) lcd_ac = 0x27;
+        else if (lcd_ac == 0xFF) lcd_ac = 0x67;
+    } else {
+        /* one line DDRAM: 0x00-0x4F */
+        if (lcd_ac == 0x50) lcd_ac = 0x00;
+        else if (lcd_ac == 0xFF) lcd_ac = 0x4F;
+    }
+}
+
+
+/*************************************************************************
+Follow an instruction or data write the way the controller would:
+update the software address counter and note how long to wait.
+*************************************************************************/
+static void lcd_track(uint8_t data, uint8_t rs)
+{
+    uint8_t t = LCD_TIMING_COMMAND;
+
+    if (rs) {
+        t = LCD_TIMING_DATA;
+        lcd_ac_step(lcd_ac_flags & LCD_AC_DEC);
+    } else if (data & (1<<LCD_DDRAM)) {
+        lcd_ac = data & 0x7F;
+        lcd_ac_flags &= ~LCD_AC_CGRAM;
+    } else if (data & (1<<LCD_CGRAM)) {
+        lcd_ac = data & 0x3F;
+        lcd_ac_flags |= LCD_AC_CGRAM;
+    } else if (data & (1<<LCD_FUNCTION)) {
+        ;
+    } else if (data & (1<<LCD_MOVE)) {
+        if ( !(data & (1<<LCD_MOVE_DISP)) )
+            lcd_ac_step( !(data & (1<<LCD_MOVE_RIGHT)) );
+    } else if (data & (1<<LCD_ON)) {
+        ;
+    } else if (data & (1<<LCD_ENTRY_MODE)) {
+        if (data & (1<<LCD_ENTRY_INC))
+            lcd_ac_flags &= ~LCD_AC_DEC;
+        else
+            lcd_ac_flags |= LCD_AC_DEC;
+    } else if (data & (1<<LCD_HOME)) {
+        t = LCD_TIMING_HOME;
+        lcd_ac = 0;
+        lcd_ac_flags &= ~LCD_AC_CGRAM;
+    } else {
+        /* clear display also sets entry mode to increment */
+        t = LCD_TIMING_CLEAR;
+        lcd_ac = 0;
+        lcd_ac_flags = 0;
+    }
+    lcd_pending = lcd_timing[t];
+}
+#endif /* LCD_WRITE_ONLY */
+
+
 /*************************************************************************
 Low-level function to write byte to LCD controller
 Input:    data   byte to write to LCD
@@ -107,8 +261,9 @@ Returns:  none
 *************************************************************************/
 static void lcd_write(uint8_t data,uint8_t rs) 
 {
+#if LCD_DATA_BITS == 4
     unsigned char dataBits ;
-
+#endif
 
     if (rs) {   /* write data        (RS=1, RW=0) */
        lcd_rs_high();
@@ -117,6 +272,53 @@ static void lcd_write(uint8_t data,uint8_t rs)
     }
     lcd_rw_low();
 
+#if LCD_DATA_BITS == 8
+    if ( lcd_data_on_one_port() )
+    {
+        /* configure data pins as output */
+        DDR(LCD_DATA0_PORT) = 0xFF;
+
+        /* output the whole byte with a single strobe */
+        LCD_DATA0_PORT = data;
+        lcd_e_toggle();
+
+        /* all data pins high (inactive) */
+        LCD_DATA0_PORT = 0xFF;
+    }
+    else
+    {
+        /* configure data pins as output */
+        DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
+        DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
+        DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
+        DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
+        DDR(LCD_DATA4_PORT) |= _BV(LCD_DATA4_PIN);
+        DDR(LCD_DATA5_PORT) |= _BV(LCD_DATA5_PIN);
+        DDR(LCD_DATA6_PORT) |= _BV(LCD_DATA6_PIN);
+        DDR(LCD_DATA7_PORT) |= _BV(LCD_DATA7_PIN);
+
+        /* output the whole byte with a single strobe */
+        if(data & 0x01) LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN); else LCD_DATA0_PORT &= ~_BV(LCD_DATA0_PIN);
+        if(data & 0x02) LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN); else LCD_DATA1_PORT &= ~_BV(LCD_DATA1_PIN);
+        if(data & 0x04) LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN); else LCD_DATA2_PORT &= ~_BV(LCD_DATA2_PIN);
+        if(data & 0x08) LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN); else LCD_DATA3_PORT &= ~_BV(LCD_DATA3_PIN);
+        if(data & 0x10) LCD_DATA4_PORT |= _BV(LCD_DATA4_PIN); else LCD_DATA4_PORT &= ~_BV(LCD_DATA4_PIN);
+        if(data & 0x20) LCD_DATA5_PORT |= _BV(LCD_DATA5_PIN); else LCD_DATA5_PORT &= ~_BV(LCD_DATA5_PIN);
+        if(data & 0x40) LCD_DATA6_PORT |= _BV(LCD_DATA6_PIN); else LCD_DATA6_PORT &= ~_BV(LCD_DATA6_PIN);
+        if(data & 0x80) LCD_DATA7_PORT |= _BV(LCD_DATA7_PIN); else LCD_DATA7_PORT &= ~_BV(LCD_DATA7_PIN);
+        lcd_e_toggle();
+
+        /* all data pins high (inactive) */
+        LCD_DATA0_PORT |= _BV(LCD_DATA0_PIN);
+        LCD_DATA1_PORT |= _BV(LCD_DATA1_PIN);
+        LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
+        LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
+        LCD_DATA4_PORT |= _BV(LCD_DATA4_PIN);
+        LCD_DATA5_PORT |= _BV(LCD_DATA5_PIN);
+        LCD_DATA6_PORT |= _BV(LCD_DATA6_PIN);
+        LCD_DATA7_PORT |= _BV(LCD_DATA7_PIN);
+    }
+#else
     if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
       && (LCD_DATA0_PIN == 0) && (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
     {
@@ -171,8 +373,20 @@ static void lcd_write(uint8_t data,uint8_t rs)
         LCD_DATA2_PORT |= _BV(LCD_DATA2_PIN);
         LCD_DATA3_PORT |= _BV(LCD_DATA3_PIN);
     }
+#endif
+#ifdef LCD_WRITE_ONLY
+    lcd_track(data, rs);
+#else
+    /* the controller loads its data register from the RAM on an address set,
+       after a data write, clear or home it still holds something else */
+    if (rs || data < (1<<LCD_ENTRY_MODE))
+        lcd_state.written = 1;
+    else if ( data & ((1<<LCD_DDRAM)|(1<<LCD_CGRAM)) )
+        lcd_state.written = 0;
+#endif
 }
 
+#if LCD_RW_USED
 /*************************************************************************
 Low-level function to read byte from LCD controller
 Input:    rs     1: read data    
@@ -190,6 +404,43 @@ static uint8_t lcd_read(uint8_t rs)
         lcd_rs_low();                        /* RS=0: read busy flag */
     lcd_rw_high();                           /* RW=1  read mode      */
     
+#if LCD_DATA_BITS == 8
+    if ( lcd_data_on_one_port() )
+    {
+        DDR(LCD_DATA0_PORT) = 0x00;          /* configure data pins as input */
+
+        lcd_e_high();
+        lcd_e_delay();
+        data = PIN(LCD_DATA0_PORT);          /* read the whole byte    */
+        lcd_e_low();
+    }
+    else
+    {
+        /* configure data pins as input */
+        DDR(LCD_DATA0_PORT) &= ~_BV(LCD_DATA0_PIN);
+        DDR(LCD_DATA1_PORT) &= ~_BV(LCD_DATA1_PIN);
+        DDR(LCD_DATA2_PORT) &= ~_BV(LCD_DATA2_PIN);
+        DDR(LCD_DATA3_PORT) &= ~_BV(LCD_DATA3_PIN);
+        DDR(LCD_DATA4_PORT) &= ~_BV(LCD_DATA4_PIN);
+        DDR(LCD_DATA5_PORT) &= ~_BV(LCD_DATA5_PIN);
+        DDR(LCD_DATA6_PORT) &= ~_BV(LCD_DATA6_PIN);
+        DDR(LCD_DATA7_PORT) &= ~_BV(LCD_DATA7_PIN);
+
+        /* read the whole byte */
+        lcd_e_high();
+        lcd_e_delay();
+        data = 0;
+        if ( PIN(LCD_DATA0_PORT) & _BV(LCD_DATA0_PIN) ) data |= 0x01;
+        if ( PIN(LCD_DATA1_PORT) & _BV(LCD_DATA1_PIN) ) data |= 0x02;
+        if ( PIN(LCD_DATA2_PORT) & _BV(LCD_DATA2_PIN) ) data |= 0x04;
+        if ( PIN(LCD_DATA3_PORT) & _BV(LCD_DATA3_PIN) ) data |= 0x08;
+        if ( PIN(LCD_DATA4_PORT) & _BV(LCD_DATA4_PIN) ) data |= 0x10;
+        if ( PIN(LCD_DATA5_PORT) & _BV(LCD_DATA5_PIN) ) data |= 0x20;
+        if ( PIN(LCD_DATA6_PORT) & _BV(LCD_DATA6_PIN) ) data |= 0x40;
+        if ( PIN(LCD_DATA7_PORT) & _BV(LCD_DATA7_PIN) ) data |= 0x80;
+        lcd_e_low();
+    }
+#else
     if ( ( &LCD_DATA0_PORT == &LCD_DATA1_PORT) && ( &LCD_DATA1_PORT == &LCD_DATA2_PORT ) && ( &LCD_DATA2_PORT == &LCD_DATA3_PORT )
       && ( LCD_DATA0_PIN == 0 )&& (LCD_DATA1_PIN == 1) && (LCD_DATA2_PIN == 2) && (LCD_DATA3_PIN == 3) )
     {
@@ -236,17 +487,37 @@ static uint8_t lcd_read(uint8_t rs)
         if ( PIN(LCD_DATA3_PORT) & _BV(LCD_DATA3_PIN) ) data |= 0x08;        
         lcd_e_low();
     }
+#endif
+    if (rs)
+        lcd_state.written = 0;   /* a read loads the next address */
     return data;
 }
+#endif /* LCD_RW_USED */
 
 
 /*************************************************************************
 loops while lcd is busy, returns address counter
 *************************************************************************/
+#ifdef LCD_WRITE_ONLY
+static uint8_t lcd_waitbusy(void)
+{
+    PROFILE_WAIT_BEGIN();
+
+    /* let the last instruction finish, then report the tracked address */
+    if (lcd_pending)
+        _delayFourCycles(lcd_pending);
+    lcd_pending = 0;
+
+    PROFILE_WAIT_END();
+    return lcd_ac;
+
+}/* lcd_waitbusy */
+#else
 static uint8_t lcd_waitbusy(void)
 
 {
     register uint8_t c;
+    PROFILE_WAIT_BEGIN();
     
     /* wait until busy flag is cleared */
     while ( (c=lcd_read(0)) & (1<<LCD_BUSY)) {}
@@ -255,55 +526,214 @@ static uint8_t lcd_waitbusy(void)
     delay(2);
 
     /* now read the address counter */
-    return (lcd_read(0));  // return address counter
+    c = lcd_read(0);
+    PROFILE_WAIT_END();
+    return c;  // return address counter
     
 }/* lcd_waitbusy */
+#endif
+
 
+#if defined(LCD_WRITE_ONLY) && defined(LCD_BUSY_CALIBRATION)
+#define LCD_CAL_TICK_US     10       /* resolution of the measurement */
+#define LCD_CAL_READ_US     8        /* upper bound for one busy flag read and loop */
+#define LCD_CAL_MAX_TICKS   1000     /* give up after 10ms: RW not wired */
 
 /*************************************************************************
-Move cursor to the start of next line or to the first line if the cursor 
-is already on the last line.
+Measure the execution time of one instruction through the busy flag
+Returns: delay loop count for the timing table, 0 if the busy flag
+         did not clear in time
 *************************************************************************/
-static inline void lcd_newline(uint8_t pos)
+static uint16_t lcd_measure(uint8_t data, uint8_t rs)
+{
+    uint16_t ticks = 1;
+
+    lcd_write(data, rs);
+
+    /* each round takes at most one tick, so ticks is an upper bound */
+    while ( lcd_read(0) & (1<<LCD_BUSY) ) {
+        if (++ticks > LCD_CAL_MAX_TICKS)
+            return 0;
+        delay(LCD_CAL_TICK_US - LCD_CAL_READ_US);
+    }
+
+    /* keep some margin for the controller clock drifting with temperature */
+    ticks += (ticks >> 3) + 1;
+
+    return ticks * LCD_DELAY_COUNT(LCD_CAL_TICK_US);
+}
+
+
+/*************************************************************************
+Fill the timing table with the real execution times of the controller
+*************************************************************************/
+static void lcd_calibrate(void)
+{
+    uint16_t t;
+
+    if ( !(t = lcd_measure(' ', 1)) ) {
+        /* no busy flag: RW is not wired, keep the datasheet timing.
+           The failed reads were seen as writes, let the last one finish. */
+        lcd_pending = lcd_timing[LCD_TIMING_COMMAND];
+        return;
+    }
+    lcd_timing[LCD_TIMING_DATA] = t;
+
+    if ( (t = lcd_measure(1<<LCD_HOME, 0)) )
+        lcd_timing[LCD_TIMING_HOME] = t;
+    if ( (t = lcd_measure(1<<LCD_CLR, 0)) )
+        lcd_timing[LCD_TIMING_CLEAR] = t;
+    if ( (t = lcd_measure(LCD_ENTRY_INC_, 0)) )
+        lcd_timing[LCD_TIMING_COMMAND] = t;
+
+    /* the busy flag has been polled to completion */
+    lcd_pending = 0;
+
+}/* lcd_calibrate */
+#endif
+
+
+
+/*************************************************************************
+Forget everything known about the controller state
+*************************************************************************/
+static void lcd_state_reset(struct lcdState *s)
 {
-    register uint8_t addressCounter;
+    s->function       = LCD_STATE_UNKNOWN;
+    s->entrymode      = LCD_STATE_UNKNOWN;
+    s->displaycontrol = LCD_STATE_UNKNOWN;
+    s->cgram          = 0;
+    s->ks0073_4lines  = 0;
+#ifndef LCD_WRITE_ONLY
+    s->written        = 1;
+#endif
+}
 
 
-    if (lcd_lines == 1)
-    	addressCounter = 0;
-    else if (lcd_lines == 4)
+/*************************************************************************
+Check an instruction against the cached controller state
+Input:    s    state of the controller the instruction is sent to
+          cmd  instruction about to be sent
+          pos  current address counter as returned by lcd_waitbusy()
+Returns:  1 if the instruction would not change anything and can be dropped,
+          0 if it has to be sent (the cache is updated accordingly)
+*************************************************************************/
+static uint8_t lcd_elide(struct lcdState *s, uint8_t cmd, uint8_t pos)
+{
+    if (cmd & (1<<LCD_DDRAM))
     {
-    	if (lcd_controller_ks0073)
-    	{
-    		if ( pos < LCD_START_LINE2 )
-    			addressCounter = LCD_START_LINE2;
-    		else if ( (pos >= LCD_START_LINE2) && (pos < LCD_START_LINE3) )
-    			addressCounter = LCD_START_LINE3;
-    		else if ( (pos >= LCD_START_LINE3) && (pos < LCD_START_LINE4) )
-    			addressCounter = LCD_START_LINE4;
-    		else 
-    			addressCounter = LCD_START_LINE1;
-    	} else {
-    		if ( pos < LCD_START_LINE3 )
-    			addressCounter = LCD_START_LINE2;
-    		else if ( (pos >= LCD_START_LINE2) && (pos < LCD_START_LINE4) )
-    			addressCounter = LCD_START_LINE3;
-    		else if ( (pos >= LCD_START_LINE3) && (pos < LCD_START_LINE2) )
-    			addressCounter = LCD_START_LINE4;
-    		else 
-    			addressCounter = LCD_START_LINE1;
-    	}
+        /* address counter already points at this DDRAM address. After a data
+           write a read returns valid data only once the address is set. */
+        if ( !s->cgram && !s->written && pos == (cmd & ~(1<<LCD_DDRAM)) )
+            return 1;
+        s->cgram = 0;
+    }
+    else if (cmd & (1<<LCD_CGRAM))
+    {
+        s->cgram = 1;
+    }
+    else if (cmd & (1<<LCD_FUNCTION))
+    {
+        if (cmd == s->function)
+            return 1;
+        s->function = cmd;
+    }
+    else if (s->function & KS0073_RE)
+    {
+        /* KS0073 extended instruction set, only the 4 lines mode is tracked */
+        if ( (cmd & 0xF8) == (1<<LCD_ON) )
+            s->ks0073_4lines = (cmd & KS0073_NW) ? 1 : 0;
+    }
+    else if (cmd & (1<<LCD_MOVE))
+    {
+        ; /* cursor/display shift always has an effect */
+    }
+    else if (cmd & (1<<LCD_ON))
+    {
+        if (cmd == s->displaycontrol)
+            return 1;
+        s->displaycontrol = cmd;
+    }
+    else if (cmd & (1<<LCD_ENTRY_MODE))
+    {
+        if (cmd == s->entrymode)
+            return 1;
+        s->entrymode = cmd;
+    }
+    else if (cmd & (1<<LCD_HOME))
+    {
+        s->cgram = 0;
     }
-    else // lcd_lines == 2
+    else if (cmd & (1<<LCD_CLR))
     {
-    	if ( pos < (LCD_START_LINE2) )
-    		addressCounter = LCD_START_LINE2;
-    	else
-    		addressCounter = LCD_START_LINE1;
+        /* clear display also sets the entry mode to increment */
+        s->cgram = 0;
+        s->entrymode |= (1<<LCD_ENTRY_INC);
     }
-    lcd_command((1<<LCD_DDRAM)+addressCounter);
+    return 0;
+}/* lcd_elide */
 
-}/* lcd_newline */
+
+/*************************************************************************
+Enable 4 lines mode of the KS0073 controller, unless already done
+*************************************************************************/
+static void lcd_ks0073_4lines(void)
+{
+    if (lcd_state.ks0073_4lines)
+        return;
+
+    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
+    lcd_command(KS0073_4LINES_MODE);
+    lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
+}
+
+
+/*************************************************************************
+Build the segment table for lcd_lines x lcd_disp_length and put the
+controller into the matching line mode:
+  one line           0x00 (80 characters)
+  one split line     0x00, 0x40 (16x1 panels wired as 8x2)
+  two lines          0x00, 0x40
+  four lines         0x00, 0x40, then lines 3 and 4 continue lines 1 and 2
+  four lines KS0073  0x00, 0x20, 0x40, 0x60
+*************************************************************************/
+static void lcd_geometry(void)
+{
+    uint8_t *start = lcd_geom.start;
+    uint8_t line, base, col, i;
+    uint8_t ks0073 = lcd_lines > 2 && lcd_controller_ks0073;
+
+    lcd_geom.split = lcd_lines == 1 && lcd_split_line;
+    lcd_geom.count = lcd_lines << lcd_geom.split;
+    lcd_geom.cursor = 0;
+    lcd_span_length = lcd_disp_length >> lcd_geom.split;
+    line = ks0073 ? 0x80 : LCD_DDRAM_LINE(lcd_geom.count);
+
+    start[0] = 0x00;
+    start[1] = ks0073 ? 0x20 : 0x40;
+    start[2] = ks0073 ? 0x40 : lcd_span_length;
+    start[3] = ks0073 ? 0x60 : 0x40 + lcd_span_length;
+
+    /* the address counter runs on from the end of a DDRAM line (40 characters,
+       80 in one line mode, the KS0073 counts through) to the start of the next */
+    for (i = 0; i < lcd_geom.count; i++) {
+        base = line == 40 ? start[i] & 0x40 : 0;
+        col = start[i] - base + lcd_span_length;
+        if (col >= line) {
+            col -= line;
+            base ^= line == 40 ? 0x40 : 0;
+        }
+        lcd_geom.end[i] = base + col;
+    }
+
+    if (ks0073)
+        lcd_ks0073_4lines();
+    else if (lcd_geom.count == 1)
+        lcd_command(LCD_FUNCTION_SET_1LINE);
+    else
+        lcd_command(LCD_FUNCTION_SET_2LINES);
+}
 
 
 /*
@@ -312,12 +742,17 @@ static inline void lcd_newline(uint8_t pos)
 
 /*************************************************************************
 Send LCD controller instruction command
+Instructions that would not change the controller state are dropped.
 Input:   instruction to send to LCD controller, see HD44780 data sheet
 Returns: none
 *************************************************************************/
 void lcd_command(uint8_t cmd)
 {
-    lcd_waitbusy();
+    uint8_t pos;
+
+    pos = lcd_waitbusy();
+    if ( lcd_elide(&lcd_state, cmd, pos) )
+        return;
     lcd_write(cmd,0);
 }
 
@@ -335,6 +770,57 @@ void lcd_data(uint8_t data)
 
 
 
+/*************************************************************************
+Segment of the display the DDRAM address <pos> is in, the address after the
+last character of a segment counts as in it. The segment the cursor was put into
+last is tried first: it settles the addresses that two segments share, like
+the start of line 3 of a HD44780 that follows the end of line 1.
+*************************************************************************/
+static uint8_t lcd_segment(uint8_t pos)
+{
+    uint8_t i = lcd_geom.cursor;
+    uint8_t best = 0;
+
+    pos -= lcd_page_base;
+    if ( (uint8_t)(pos - lcd_geom.start[i]) < lcd_span_length || pos == lcd_geom.end[i] )
+        return i;
+
+    /* off the visible part: the nearest segment starting before pos */
+    for (i = 0; i < lcd_geom.count; i++) {
+        if ( (uint8_t)(pos - lcd_geom.start[i]) < lcd_span_length )
+            return i;
+        if ( (uint8_t)(pos - lcd_geom.start[i]) < (uint8_t)(pos - lcd_geom.start[best]) )
+            best = i;
+    }
+    return best;
+}
+
+
+/*************************************************************************
+Put the cursor at the start of segment <i>
+*************************************************************************/
+static void lcd_segment_start(uint8_t i)
+{
+    lcd_geom.cursor = i;
+    lcd_command((1<<LCD_DDRAM)+lcd_geom.start[i]+lcd_page_base);
+}
+
+
+/*************************************************************************
+Move cursor to the start of next line or to the first line if the cursor 
+is already on the last line.
+*************************************************************************/
+static inline void lcd_newline(uint8_t pos)
+{
+    uint8_t i = lcd_segment(pos) | lcd_geom.split;  /* last segment of the line */
+
+    if (++i >= lcd_geom.count)
+        i = 0;
+    lcd_segment_start(i);
+
+}/* lcd_newline */
+
+
 /*************************************************************************
 Set cursor to specified position
 Input:    x  horizontal position  (0: left most position)
@@ -343,29 +829,34 @@ Returns:  none
 *************************************************************************/
 void lcd_gotoxy(uint8_t x, uint8_t y)
 {
-	if (lcd_lines == 1)
-		lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-	else if (lcd_lines == 4)
-	{
-		if ( y==0 )
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-		else if ( y==1)
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
-		else if ( y==2)
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE3+x);
-		else /* y==3 */
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE4+x);
-	}
-	else // lcd_lines == 2
-	{
-		if ( y==0 ) 
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE1+x);
-		else
-			lcd_command((1<<LCD_DDRAM)+LCD_START_LINE2+x);
+	uint8_t i;
+
+	if (y >= lcd_lines)
+		y = lcd_lines - 1;
+	i = y << lcd_geom.split;
+	if (lcd_geom.split && x >= lcd_span_length) {
+		x -= lcd_span_length;
+		i++;
 	}
+	lcd_geom.cursor = i;
+	lcd_command((1<<LCD_DDRAM)+lcd_geom.start[i]+lcd_page_base+x);
 }/* lcd_gotoxy */
 
 
+/*************************************************************************
+Set the cursor for reading: the address is set even when the address counter
+is already there, after a data write the controller needs that to read
+valid data
+*************************************************************************/
+void lcd_seek(uint8_t x, uint8_t y)
+{
+#ifndef LCD_WRITE_ONLY
+    lcd_state.written = 1;   /* keeps lcd_elide() from dropping the address set */
+#endif
+    lcd_gotoxy(x, y);
+}
+
+
 /*************************************************************************
 *************************************************************************/
 int lcd_getxy(void)
@@ -374,12 +865,119 @@ int lcd_getxy(void)
 }
 
 
+/*************************************************************************
+Line and column of the cursor
+*************************************************************************/
+uint8_t lcd_where(uint8_t *x)
+{
+    uint8_t pos = lcd_waitbusy();
+    uint8_t i = lcd_segment(pos);
+
+    *x = pos - lcd_geom.start[i] - lcd_page_base;
+    if (i & lcd_geom.split)
+        *x += lcd_span_length;
+    return i >> lcd_geom.split;
+}
+
+
+/*************************************************************************
+Fill columns x..x1 of lines y..y1 with a character, with one address set
+per line. The cursor stays where it is.
+*************************************************************************/
+void lcd_fill(uint8_t x, uint8_t y, uint8_t x1, uint8_t y1, char c)
+{
+    uint8_t cx, cy, i;
+
+    cy = lcd_where(&cx);
+    if (x1 >= lcd_disp_length)
+        x1 = lcd_disp_length - 1;
+    if (y1 >= lcd_lines)
+        y1 = lcd_lines - 1;
+
+    for (; y <= y1; y++) {
+        lcd_gotoxy(x, y);
+        for (i = x; i <= x1; i++) {
+            if (i == lcd_span_length && lcd_geom.split)
+                lcd_gotoxy(i, y);
+            lcd_putraw(c);
+        }
+    }
+    lcd_gotoxy(cx, cy);
+}
+
+
+/*************************************************************************
+Clear from the cursor to the end of the line or of the screen, the cursor
+stays where it is
+*************************************************************************/
+void lcd_clreol(void)
+{
+    uint8_t x, y;
+
+    y = lcd_where(&x);
+    lcd_fill(x, y, 0xff, y, ' ');
+}
+
+void lcd_clreos(void)
+{
+    uint8_t x, y;
+
+    y = lcd_where(&x);
+    lcd_fill(0, y + 1, 0xff, 0xff, ' ');
+    lcd_fill(x, y, 0xff, y, ' ');
+}
+
+
+#ifndef LCD_WRITE_ONLY
+/*************************************************************************
+Read the character at the current cursor position, the cursor advances
+the same way as after writing one
+*************************************************************************/
+uint8_t lcd_getc(void)
+{
+    lcd_waitbusy();
+    return lcd_read(1);
+}
+
+
+/*************************************************************************
+Which of the custom characters 0-7 are on the screen, as a bit mask. The
+cursor stays where it is.
+*************************************************************************/
+uint8_t lcd_cgram_visible(void)
+{
+    uint8_t ac = lcd_waitbusy();
+    uint8_t mask = 0;
+    uint8_t i, x, c;
+
+    lcd_state.written = 1;   /* set the address before reading */
+    for (i = 0; i < lcd_geom.count; i++) {
+        lcd_command((1<<LCD_DDRAM)+lcd_geom.start[i]+lcd_page_base);
+        for (x = 0; x < lcd_span_length; x++) {
+            c = lcd_getc();
+            if (c < 8)
+                mask |= _BV(c);
+        }
+    }
+
+    lcd_command((1<<LCD_DDRAM)+ac);
+    return mask;
+}
+#endif
+
+
 /*************************************************************************
 Clear display and set cursor to home position
 *************************************************************************/
 void lcd_clrscr(void)
 {
     lcd_command(1<<LCD_CLR);
+#ifdef FEATURE_PAGES
+    /* clearing also undoes the display shift: page 0 is shown */
+    lcd_page_shift = 0;
+    if (lcd_page_base)
+        lcd_gotoxy(0, 0);
+#endif
 }
 
 
@@ -389,7 +987,68 @@ Set cursor to home position
 void lcd_home(void)
 {
     lcd_command(1<<LCD_HOME);
+#ifdef FEATURE_PAGES
+    lcd_page_shift = 0;
+    if (lcd_page_base)
+        lcd_gotoxy(0, 0);
+#endif
+}
+
+
+#ifdef FEATURE_PAGES
+/*************************************************************************
+Number of pages the DDRAM holds in the current geometry. The display
+shift only moves whole lines of one and two line displays.
+*************************************************************************/
+uint8_t lcd_pages(void)
+{
+    uint8_t n = 0;
+
+    if (lcd_lines <= 2 && !lcd_geom.split && lcd_disp_length)
+        n = LCD_DDRAM_LINE(lcd_lines) / lcd_disp_length;
+    return n ? n : 1;
+}
+
+
+/*************************************************************************
+Select the page text is written to and put the cursor at its top left
+Input:    page  0 .. lcd_pages()-1
+*************************************************************************/
+void lcd_page_write(uint8_t page)
+{
+    if (page >= lcd_pages())
+        return;
+    lcd_page_base = page * lcd_disp_length;
+    lcd_gotoxy(0, 0);
+}
+
+
+/*************************************************************************
+Show a page by shifting the display, in whichever direction takes
+fewer instructions. The contents and the cursor are not touched.
+Input:    page  0 .. lcd_pages()-1
+*************************************************************************/
+void lcd_page_show(uint8_t page)
+{
+    uint8_t width = LCD_DDRAM_LINE(lcd_lines);
+    uint8_t target = page * lcd_disp_length;
+    uint8_t n;
+
+    if (page >= lcd_pages())
+        return;
+
+    /* columns to shift the display left */
+    n = (target + width - lcd_page_shift) % width;
+    lcd_page_shift = target;
+
+    if (n > width / 2)
+        for (n = width - n; n; n--)
+            lcd_command(LCD_MOVE_DISP_RIGHT);
+    else
+        for (; n; n--)
+            lcd_command(LCD_MOVE_DISP_LEFT);
 }
+#endif
 
 
 /*************************************************************************
@@ -413,35 +1072,21 @@ void lcd_putc(char c)
     }
     else
     {
-    	if (lcd_wrap_lines == 1)
+    	if (lcd_wrap_lines || lcd_geom.split)
     	{
-    		if (lcd_lines == 1)
-    		{
-    			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
+    		/* at the end of a segment: on to the next one, the second half
+    		   of a split line always follows the first */
+    		uint8_t i = lcd_segment(pos);
+
+    		if ( (uint8_t)(pos - lcd_page_base) == lcd_geom.end[i] ) {
+    			if (++i >= lcd_geom.count)
+    				i = 0;
+    			if (lcd_wrap_lines || (i & lcd_geom.split)) {
+    				lcd_geom.cursor = i;
+    				lcd_write((1<<LCD_DDRAM)+lcd_geom.start[i]+lcd_page_base,0);
+    				lcd_waitbusy();
     			}
     		}
-    		else if (lcd_lines == 4)
-    		{
-    			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE2,0);    
-    			}else if ( pos == LCD_START_LINE2+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE3,0);
-    			}else if ( pos == LCD_START_LINE3+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE4,0);
-    			}else if ( pos == LCD_START_LINE4+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
-    			}
-    		}
-    		else // lcd_lines == 2
-    		{
-    			if ( pos == LCD_START_LINE1+lcd_disp_length ) {
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE2,0);    
-    			}else if ( pos == LCD_START_LINE2+lcd_disp_length ){
-    				lcd_write((1<<LCD_DDRAM)+LCD_START_LINE1,0);
-    			}
-    		}
-    		lcd_waitbusy();
     	}
         lcd_write(c, 1);
     }
@@ -493,6 +1138,45 @@ Returns:  none
 *************************************************************************/
 void lcd_init(uint8_t dispAttr)
 {
+#if LCD_DATA_BITS == 8
+    /*
+     *  Initialize LCD to 8 bit I/O mode
+     */
+
+    if ( lcd_data_on_one_port() )
+    {
+        /* configure all port bits as output (all LCD data lines on same port) */
+        DDR(LCD_DATA0_PORT) = 0xFF;
+    }
+    else
+    {
+        /* configure data pins as output (LCD data lines spread over several ports) */
+        DDR(LCD_DATA0_PORT) |= _BV(LCD_DATA0_PIN);
+        DDR(LCD_DATA1_PORT) |= _BV(LCD_DATA1_PIN);
+        DDR(LCD_DATA2_PORT) |= _BV(LCD_DATA2_PIN);
+        DDR(LCD_DATA3_PORT) |= _BV(LCD_DATA3_PIN);
+        DDR(LCD_DATA4_PORT) |= _BV(LCD_DATA4_PIN);
+        DDR(LCD_DATA5_PORT) |= _BV(LCD_DATA5_PIN);
+        DDR(LCD_DATA6_PORT) |= _BV(LCD_DATA6_PIN);
+        DDR(LCD_DATA7_PORT) |= _BV(LCD_DATA7_PIN);
+    }
+    DDR(LCD_RS_PORT)    |= _BV(LCD_RS_PIN);
+    DDR(LCD_RW_PORT)    |= _BV(LCD_RW_PIN);
+    DDR(LCD_E_PORT)     |= _BV(LCD_E_PIN);
+    delay(16000);        /* wait 16ms or more after power-on       */
+
+    /* function set 8bit, three times as for the 4bit initialisation */
+    lcd_write(LCD_FUNCTION_8BIT_1LINE,0);
+    delay(4992);         /* delay, busy flag can't be checked here */
+
+    lcd_write(LCD_FUNCTION_8BIT_1LINE,0);
+    delay(64);           /* delay, busy flag can't be checked here */
+
+    lcd_write(LCD_FUNCTION_8BIT_1LINE,0);
+    delay(64);           /* delay, busy flag can't be checked here */
+
+    /* from now on the busy flag can be read, we can use lcd_command() */
+#else
     /*
      *  Initialize LCD to 4 bit I/O mode
      */
@@ -547,18 +1231,15 @@ void lcd_init(uint8_t dispAttr)
     delay(64);           /* some displays need this additional delay */
     
     /* from now the LCD only accepts 4 bit I/O, we can use lcd_command() */    
-
-if (lcd_lines == 4 && lcd_controller_ks0073)
-{
-    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
-	lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-	lcd_command(KS0073_4LINES_MODE);
-	lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-}
-else if (lcd_lines == 1)
-    lcd_command(LCD_FUNCTION_4BIT_1LINE);      /* function set: display lines  */
-else //lcd_lines == 2
-	lcd_command(LCD_FUNCTION_4BIT_2LINES);
+#endif
+#if !LCD_RW_USED
+    DDR(LCD_RW_PORT) &= ~_BV(LCD_RW_PIN);    /* RW is tied low, release the pin */
+#endif
+#if defined(LCD_WRITE_ONLY) && defined(LCD_BUSY_CALIBRATION)
+    lcd_calibrate();
+#endif
+    lcd_state_reset(&lcd_state);
+    lcd_geometry();                         /* function set: display lines  */
 
     lcd_command(LCD_DISP_OFF);              /* display off                  */
     lcd_clrscr();                           /* display clear                */ 
@@ -570,23 +1251,16 @@ else //lcd_lines == 2
 
 void lcd_setup(uint8_t col, uint8_t row)
 {
-	if (lcd_lines != row)
-	{
-		lcd_lines = row;
-		if (lcd_lines == 4 && lcd_controller_ks0073)
-		{
-		    /* Display with KS0073 controller requires special commands for enabling 4 line mode */
-			lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-			lcd_command(KS0073_4LINES_MODE);
-			lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-		}
-		else if (lcd_lines == 1)
-		    lcd_command(LCD_FUNCTION_4BIT_1LINE);      /* function set: display lines  */
-		else // lcd_lines == 2
-			lcd_command(LCD_FUNCTION_4BIT_2LINES);
-	}
-	if (lcd_disp_length != col)
-		lcd_disp_length = col;
+#ifdef FEATURE_PAGES
+	lcd_page_base = 0;
+#endif
+	if (row == 0)
+		row = 1;
+	else if (row > LCD_SEGMENTS)
+		row = LCD_SEGMENTS;
+	lcd_lines = row;
+	lcd_disp_length = col;
+	lcd_geometry();
 }
 
 void lcd_linewrap(uint8_t on)
@@ -597,11 +1271,32 @@ void lcd_linewrap(uint8_t on)
 void lcd_ks0073(uint8_t on)
 {
 	lcd_controller_ks0073 = on;
-	if(on)
-	{
-		/* Display with KS0073 controller requires special commands for enabling 4 line mode */
-		lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_ON);
-		lcd_command(KS0073_4LINES_MODE);
-		lcd_command(KS0073_EXTENDED_FUNCTION_REGISTER_OFF);
-	}
-}
\ No newline at end of file
+	lcd_geometry();
+}
+
+void lcd_split(uint8_t on)
+{
+	lcd_split_line = on;
+	lcd_geometry();
+}
+
+void lcd_createCharacter(uint8_t pos, uint8_t *data)
+{
+	uint8_t ac = lcd_waitbusy();
+
+	lcd_command(_BV(LCD_CGRAM) | (pos<<3)); // set CG RAM start address
+
+	for(uint8_t i = 0; i < 8; i++)
+		lcd_data(data[i]);
+	lcd_command(_BV(LCD_DDRAM) | ac); // back to the cursor
+}
+
+void lcd_createCharacter_p(uint8_t pos, const uint8_t *progmem_data)
+{
+	uint8_t ac = lcd_waitbusy();
+
+	lcd_command(_BV(LCD_CGRAM) | (pos<<3));
+	for(uint8_t i = 0; i < 8; i++)
+		lcd_data(pgm_read_byte(progmem_data + i));
+	lcd_command(_BV(LCD_DDRAM) | ac); // back to the cursor
+}
@@ -21,7 +21,8 @@
  added 4-bit I/O mode, improved and optimized code.
        
  Library can be operated in memory mapped mode (LCD_IO_MODE=0) or in 
- 4-bit IO port mode (LCD_IO_MODE=1). 8-bit IO port mode not supported.
+ IO port mode (LCD_IO_MODE=1). In IO port mode the data bus is 4 bits wide,
+ or 8 bits wide when built with LCD_8BIT_MODE (see Makefile.config).
 
  Memory mapped mode compatible with Kanda STK200, but supports also 
  generation of R/W signal through A8 address line.
@@ -57,9 +58,88 @@
 #define LCD_START_LINE2  0x40     /**< DDRAM address of first char of line 2 */
 #define LCD_START_LINE3  0x14     /**< DDRAM address of first char of line 3 */
 #define LCD_START_LINE4  0x54     /**< DDRAM address of first char of line 4 */
+#define LCD_DDRAM_LINE(lines) ((lines) == 1 ? 80 : 40) /**< DDRAM characters per line */
 
 #define LCD_IO_MODE      1         /**< 0: memory mapped mode, 1: IO port mode */
 
+#ifdef LCD_8BIT_MODE
+#define LCD_DATA_BITS    8         /**< width of the data bus: 4 or 8 */
+#else
+#define LCD_DATA_BITS    4         /**< width of the data bus: 4 or 8 */
+#endif
+
+#if LCD_DATA_BITS == 8
+
+/**
+ *  @name Definitions for 8-bit IO mode
+ *  LCD_DATA0..7 are the data lines D0..D7 of the display.
+ *
+ *  Normally the eight data lines should be mapped to bit 0..7 of one port, so a
+ *  byte can be written with a single port access. They can also be connected in
+ *  a different order or spread over several ports by adapting the LCD_DATAx_PORT
+ *  and LCD_DATAx_PIN definitions, at the cost of a slower bit-by-bit transfer.
+ *
+ *  The ATtiny2313/4313 have no free 8 bit port (PORTB carries the USI and the
+ *  backlight PWM), so there the data lines are spread over the free pins.
+ */
+#if defined(__AVR_ATtiny2313__) || defined(__AVR_ATtiny4313__)
+#define LCD_PORT         PORTD        /**< port for the LCD control lines */
+#define LCD_DATA0_PORT   PORTD        /**< port for 8bit data bit 0 */
+#define LCD_DATA1_PORT   PORTD        /**< port for 8bit data bit 1 */
+#define LCD_DATA2_PORT   PORTD        /**< port for 8bit data bit 2 */
+#define LCD_DATA3_PORT   PORTD        /**< port for 8bit data bit 3 */
+#define LCD_DATA4_PORT   PORTB        /**< port for 8bit data bit 4 */
+#define LCD_DATA5_PORT   PORTB        /**< port for 8bit data bit 5 */
+#define LCD_DATA6_PORT   PORTB        /**< port for 8bit data bit 6 */
+#define LCD_DATA7_PORT   PORTA        /**< port for 8bit data bit 7 */
+#define LCD_DATA0_PIN    0            /**< pin for 8bit data bit 0  */
+#define LCD_DATA1_PIN    1            /**< pin for 8bit data bit 1  */
+#define LCD_DATA2_PIN    2            /**< pin for 8bit data bit 2  */
+#define LCD_DATA3_PIN    3            /**< pin for 8bit data bit 3  */
+#define LCD_DATA4_PIN    0            /**< pin for 8bit data bit 4  */
+#define LCD_DATA5_PIN    3            /**< pin for 8bit data bit 5  */
+#define LCD_DATA6_PIN    6            /**< pin for 8bit data bit 6  */
+#define LCD_DATA7_PIN    0            /**< pin for 8bit data bit 7  */
+#ifdef MAX5160
+#error "LCD_8BIT_MODE uses PB3, which is the MAX5160 INC line"
+#endif
+#ifdef FEATURE_UART
+#error "FEATURE_UART uses PD0/PD1 (RXD/TXD), which are LCD data lines in LCD_8BIT_MODE"
+#endif
+#else
+#define LCD_PORT         PORTD        /**< port for the LCD control lines */
+#define LCD_DATA_PORT    PORTB        /**< port for the LCD data lines    */
+#define LCD_DATA0_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 0 */
+#define LCD_DATA1_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 1 */
+#define LCD_DATA2_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 2 */
+#define LCD_DATA3_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 3 */
+#define LCD_DATA4_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 4 */
+#define LCD_DATA5_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 5 */
+#define LCD_DATA6_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 6 */
+#define LCD_DATA7_PORT   LCD_DATA_PORT     /**< port for 8bit data bit 7 */
+#define LCD_DATA0_PIN    0            /**< pin for 8bit data bit 0  */
+#define LCD_DATA1_PIN    1            /**< pin for 8bit data bit 1  */
+#define LCD_DATA2_PIN    2            /**< pin for 8bit data bit 2  */
+#define LCD_DATA3_PIN    3            /**< pin for 8bit data bit 3  */
+#define LCD_DATA4_PIN    4            /**< pin for 8bit data bit 4  */
+#define LCD_DATA5_PIN    5            /**< pin for 8bit data bit 5  */
+#define LCD_DATA6_PIN    6            /**< pin for 8bit data bit 6  */
+#define LCD_DATA7_PIN    7            /**< pin for 8bit data bit 7  */
+#endif
+#define LCD_RS_PORT      LCD_PORT     /**< port for RS line         */
+#define LCD_RS_PIN       4            /**< pin  for RS line         */
+#define LCD_RW_PORT      LCD_PORT     /**< port for RW line         */
+#define LCD_RW_PIN       5            /**< pin  for RW line         */
+#define LCD_E_PORT       LCD_PORT     /**< port for Enable line     */
+#define LCD_E_PIN        6            /**< pin  for Enable line     */
+
+#if (LCD_DATA0_PIN > 7) || (LCD_DATA1_PIN > 7) || (LCD_DATA2_PIN > 7) || (LCD_DATA3_PIN > 7) \
+ || (LCD_DATA4_PIN > 7) || (LCD_DATA5_PIN > 7) || (LCD_DATA6_PIN > 7) || (LCD_DATA7_PIN > 7)
+#error "LCD_DATAx_PIN must be in the range 0..7"
+#endif
+
+#else
+
 /**
  *  @name Definitions for 4-bit IO mode
  *  Change LCD_PORT if you want to use a different port for the LCD pins.
@@ -73,7 +153,11 @@
  *  is possible to connect these data lines in different order or even on different
  *  ports by adapting the LCD_DATAx_PORT and LCD_DATAx_PIN definitions.
  *  
+ *  A board that has the LCD on other pins can also define LCD_PORT and all of
+ *  the lines below before this file is read (on the compiler command line or
+ *  in a header included first), the defaults are not used then.
  */
+#ifndef LCD_PORT
 #define LCD_PORT         PORTD        /**< port for the LCD lines   */
 #define LCD_DATA0_PORT   LCD_PORT     /**< port for 4bit data bit 0 */
 #define LCD_DATA1_PORT   LCD_PORT     /**< port for 4bit data bit 1 */
@@ -89,6 +173,46 @@
 #define LCD_RW_PIN       5            /**< pin  for RW line         */
 #define LCD_E_PORT       LCD_PORT     /**< port for Enable line     */
 #define LCD_E_PIN        6            /**< pin  for Enable line     */
+#ifdef FEATURE_UART
+#error "FEATURE_UART uses PD0/PD1 (RXD/TXD), which are LCD data lines here, define the LCD pins of the board"
+#endif
+#endif /* LCD_PORT */
+
+#if (LCD_DATA0_PIN > 7) || (LCD_DATA1_PIN > 7) || (LCD_DATA2_PIN > 7) || (LCD_DATA3_PIN > 7)
+#error "LCD_DATAx_PIN must be in the range 0..7"
+#endif
+
+#endif /* LCD_DATA_BITS */
+
+#if (LCD_RS_PIN > 7) || (LCD_RW_PIN > 7) || (LCD_E_PIN > 7)
+#error "LCD_RS_PIN, LCD_RW_PIN and LCD_E_PIN must be in the range 0..7"
+#endif
+
+/**
+ *  @name Definitions for write-only mode
+ *  With LCD_WRITE_ONLY the busy flag is never polled during operation. RW is
+ *  held low and every instruction is followed by a fixed delay taken from a
+ *  timing table. The address counter is tracked in software.
+ *
+ *  By default the datasheet values below are used and the RW pin is left
+ *  free (tie RW of the LCD to GND). With LCD_BUSY_CALIBRATION as well,
+ *  lcd_init() measures the controller's real execution times once through the
+ *  busy flag and fills the timing table with them. This needs RW wired, the
+ *  pin is driven by the library; if the busy flag never clears the datasheet
+ *  values are kept.
+ *
+ *  Execution times in microseconds, with margin for slow controller clocks.
+ */
+#define LCD_DELAY_CLEAR_US    2000    /**< clear display                    */
+#define LCD_DELAY_HOME_US     2000    /**< return home                      */
+#define LCD_DELAY_COMMAND_US  50      /**< all other instructions           */
+#define LCD_DELAY_DATA_US     50      /**< data write incl. address update  */
+
+#if !defined(LCD_WRITE_ONLY) || defined(LCD_BUSY_CALIBRATION)
+#define LCD_RW_USED      1            /**< RW line is driven by the library */
+#else
+#define LCD_RW_USED      0
+#endif
 
 /**
  *  @name Definitions for LCD command instructions
@@ -158,6 +282,14 @@
 #define LCD_FUNCTION_8BIT_1LINE  0x30   /* 8-bit interface, single line, 5x7 dots */
 #define LCD_FUNCTION_8BIT_2LINES 0x38   /* 8-bit interface, dual line,   5x7 dots */
 
+#if LCD_DATA_BITS == 8
+#define LCD_FUNCTION_SET_1LINE   LCD_FUNCTION_8BIT_1LINE   /* function set for the configured bus width */
+#define LCD_FUNCTION_SET_2LINES  LCD_FUNCTION_8BIT_2LINES
+#else
+#define LCD_FUNCTION_SET_1LINE   LCD_FUNCTION_4BIT_1LINE   /* function set for the configured bus width */
+#define LCD_FUNCTION_SET_2LINES  LCD_FUNCTION_4BIT_2LINES
+#endif
+
 
 #define LCD_MODE_DEFAULT     ((1<<LCD_ENTRY_MODE) | (1<<LCD_ENTRY_INC) )
 
@@ -178,10 +310,29 @@
 */
 extern void lcd_init(uint8_t dispAttr);
 
+extern uint8_t lcd_lines;
+extern uint8_t lcd_disp_length;
+
 extern void lcd_setup(uint8_t col, uint8_t row);
 extern void lcd_linewrap(uint8_t on);
 extern void lcd_ks0073(uint8_t on);
 
+
+/**
+ @brief    Geometry
+
+ lcd_setup(), lcd_ks0073() and lcd_split() build a table with the DDRAM
+ address each line starts at, cursor positions are looked up in it. Up to
+ four lines, lines 3 and 4 of a HD44780 continue lines 1 and 2 in DDRAM.
+
+ Panels with split addressing (16x1 wired as 8x2) are driven in two line mode,
+ the second half of the line follows the first at 0x40. lcd_putc() and
+ lcd_gotoxy() handle the split, lcd_putraw() and lcd_getc() do not: they run
+ through lcd_span_length characters from the start of a line or half line.
+*/
+extern uint8_t lcd_span_length;
+extern void lcd_split(uint8_t on);
+
 /**
  @brief    Clear display and set cursor to home position
  @param    void                                        
@@ -198,6 +349,34 @@ extern void lcd_clrscr(void);
 extern void lcd_home(void);
 
 
+/**
+ @brief    Fill a rectangle with a character, the cursor stays where it is
+ @param    x  first column
+ @param    y  first line
+ @param    x1 last column, clipped to the display
+ @param    y1 last line, clipped to the display
+ @param    c  character code, control characters are not interpreted
+ @return   none
+*/
+extern void lcd_fill(uint8_t x, uint8_t y, uint8_t x1, uint8_t y1, char c);
+
+
+/**
+ @brief    Clear from the cursor to the end of the line, the cursor stays
+ @param    void
+ @return   none
+*/
+extern void lcd_clreol(void);
+
+
+/**
+ @brief    Clear from the cursor to the end of the screen, the cursor stays
+ @param    void
+ @return   none
+*/
+extern void lcd_clreos(void);
+
+
 /**
  @brief    Set cursor to specified position
  
@@ -208,6 +387,35 @@ extern void lcd_home(void);
 extern void lcd_gotoxy(uint8_t x, uint8_t y);
 
 
+/**
+ @brief    Set the cursor before reading with lcd_getc(): like lcd_gotoxy(),
+           but the address is set even when the cursor is already there,
+           the LCD returns stale data after a write until then.
+           The same as lcd_gotoxy() with LCD_WRITE_ONLY.
+ @param    x horizontal position\n (0: left most position)
+ @param    y vertical position\n   (0: first line)
+ @return   none
+*/
+extern void lcd_seek(uint8_t x, uint8_t y);
+
+
+/**
+ @brief    Find the cursor, lcd_gotoxy() takes it back there
+ @param    x the column is stored here
+ @return   line of the cursor
+*/
+extern uint8_t lcd_where(uint8_t *x);
+
+
+/**
+ @brief    Read the address counter, for example to come back to the
+           cursor after writing CGRAM
+ @param    void
+ @return   DDRAM address of the cursor
+*/
+extern int lcd_getxy(void);
+
+
 /**
  @brief    Display character at current cursor position
  @param    c character to be displayed                                       
@@ -235,6 +443,10 @@ extern void lcd_puts_p(const char *progmem_s);
 
 /**
  @brief    Send LCD controller instruction command
+
+ Instructions that would not change the state of the controller (e.g. setting
+ the display control or entry mode to the value it already has, or the DDRAM
+ address the cursor is already at) are dropped.
  @param    cmd instruction to send to LCD controller, see HD44780 data sheet
  @return   none
 */
@@ -251,6 +463,53 @@ extern void lcd_command(uint8_t cmd);
 extern void lcd_data(uint8_t data);
 
 
+/**
+ @brief    Display character code at current cursor position
+
+ Unlike lcd_putc(), control characters and line wrap are not interpreted
+ @param    c character code
+ @return   none
+*/
+#define lcd_putraw(c)           lcd_data(c)
+
+
+/**
+ @brief    Read character code at current cursor position, the cursor
+           advances as after a write. Not available with LCD_WRITE_ONLY.
+ @param    void
+ @return   character code, or data byte when the address is in CGRAM
+*/
+extern uint8_t lcd_getc(void);
+
+/**
+ @brief    Find the custom characters shown on the screen, the cursor stays
+           where it is. Not available with LCD_WRITE_ONLY.
+ @param    void
+ @return   bit mask, bit n set when character n is on the screen
+*/
+extern uint8_t lcd_cgram_visible(void);
+
+/* define character <pos>, the cursor stays where it is */
+extern void lcd_createCharacter(uint8_t pos, uint8_t *data);
+
+/* the same from program memory */
+extern void lcd_createCharacter_p(uint8_t pos, const uint8_t *progmem_data);
+
+
+/**
+ @brief    Pages (FEATURE_PAGES)
+
+ One and two line displays narrower than the DDRAM hold further pages of text
+ to the right of the visible one, lcd_pages() of them. lcd_page_write()
+ selects the page lcd_gotoxy(), lcd_putc() and the line wrap work on,
+ lcd_page_show() brings a page into view with the display shift. Clearing
+ the display and home show page 0 again, scrolling moves the pages as well.
+*/
+extern uint8_t lcd_pages(void);
+extern void lcd_page_write(uint8_t page);
+extern void lcd_page_show(uint8_t page);
+
+
 /**
  @brief macros for automatically storing string constant in program memory
 */
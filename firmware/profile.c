@@ -0,0 +1,108 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_PROFILING
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#include "profile.h"
+#include "usiTwiSlave.h"
+#include "input.h"
+
+struct profile profile;
+
+void profile_init(void)
+{
+	// Timer1 free running at F_CPU/8, no interrupts
+	TCCR1A = 0;
+	TCCR1B = _BV(CS11);
+}
+
+void profile_reset(void)
+{
+	memset(&profile, 0, sizeof(profile));
+
+	cli();
+	usiTwiRxCount = 0;
+	usiTwiRxStalls = 0;
+	sei();
+}
+
+// Account for a command that started at <start> and has just been processed
+void profile_command(uint8_t opcode, uint16_t start)
+{
+	uint16_t t = profile_clock() - start;
+	uint16_t bound = PROFILE_BUCKET_US;
+	uint8_t i;
+
+	profile.commands[(opcode & 0x80) ? (opcode >> 4) - 7 : 0]++;
+
+	if (t > profile.max_latency)
+		profile.max_latency = t;
+
+	for (i = 0; i < PROFILE_BUCKETS - 1 && t >= bound; i++)
+		bound <<= 1;
+	profile.histogram[i]++;
+}
+
+static void send16(uint16_t v)
+{
+	input_transmitByte(v);
+	input_transmitByte(v >> 8);
+}
+
+static void send32(uint32_t v)
+{
+	send16(v);
+	send16(v >> 16);
+}
+
+void profile_send(uint8_t group)
+{
+	uint32_t bytes;
+	uint16_t stalls;
+	uint16_t total = 0;
+	uint8_t i;
+
+	switch (group) {
+		case PROFILE_GROUP_TOTALS:
+			cli();
+			bytes = usiTwiRxCount;
+			stalls = usiTwiRxStalls;
+			sei();
+
+			for (i = 0; i < PROFILE_CLASSES; i++)
+				total += profile.commands[i];
+
+			send32(bytes);
+			send16(stalls);
+			send32(profile.waitbusy);
+			send16(profile.max_latency);
+			send16(total);
+			break;
+		case PROFILE_GROUP_COMMANDS:
+			for (i = 0; i < PROFILE_CLASSES; i++)
+				send16(profile.commands[i]);
+			break;
+		case PROFILE_GROUP_HISTOGRAM:
+			for (i = 0; i < PROFILE_BUCKETS; i++)
+				send16(profile.histogram[i]);
+			break;
+	}
+}
+
+#endif // FEATURE_PROFILING
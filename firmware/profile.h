@@ -0,0 +1,85 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Performance counters (FEATURE_PROFILING)
+ *
+ * Timer1 runs free at F_CPU/8, one tick per microsecond at 8MHz, and is
+ * used to time the busy waits of the LCD driver and the processing of each
+ * command. The counters are read with command 0x8c and cleared with 0x8d.
+ *
+ * 0x8c takes the group to send as argument, each group fits the 32 byte
+ * buffer of the Arduino Wire library. All values are little endian.
+ *
+ *   group 0: totals (14 bytes)
+ *     uint32  bytes received
+ *     uint16  times the master was held because the RX buffer was full
+ *     uint32  microseconds spent waiting for the LCD in lcd_waitbusy()
+ *     uint16  longest command processing time in microseconds
+ *     uint16  commands processed
+ *   group 1: commands processed per opcode class (18 bytes)
+ *     uint16  text, 0x80-0x8f, 0x90-0x9f, ..., 0xf0-0xff
+ *   group 2: histogram of the command processing time (16 bytes)
+ *     uint16  < 32us, < 64us, < 128us, ..., < 2048us, longer
+ *
+ * The processing time of a command runs from fetching its first byte to
+ * the end of processTWI(), so it includes waiting for argument bytes
+ * that are still on the bus.
+ */
+
+#ifndef PROFILE_H__
+#define PROFILE_H__
+
+#ifdef FEATURE_PROFILING
+
+#include <avr/io.h>
+
+#define PROFILE_CLASSES     9        /* text and the eight 0x10 wide opcode ranges above 0x80 */
+#define PROFILE_BUCKETS     8
+#define PROFILE_BUCKET_US   32       /* upper bound of the first bucket */
+
+#define PROFILE_GROUP_TOTALS      0
+#define PROFILE_GROUP_COMMANDS    1
+#define PROFILE_GROUP_HISTOGRAM   2
+
+struct profile {
+    uint32_t waitbusy;               /* us in lcd_waitbusy() */
+    uint16_t max_latency;            /* us, longest processTWI() */
+    uint16_t commands[PROFILE_CLASSES];
+    uint16_t histogram[PROFILE_BUCKETS];
+};
+
+extern struct profile profile;
+
+void profile_init(void);
+void profile_reset(void);
+void profile_command(uint8_t opcode, uint16_t start);
+void profile_send(uint8_t group);
+
+/* microseconds at 8MHz, wraps after 65ms */
+#define profile_clock()         TCNT1
+
+/* time the busy wait of the LCD driver */
+#define PROFILE_WAIT_BEGIN()    uint16_t profile_wait_start = profile_clock()
+#define PROFILE_WAIT_END()      profile.waitbusy += (uint16_t)(profile_clock() - profile_wait_start)
+
+#else
+
+#define PROFILE_WAIT_BEGIN()
+#define PROFILE_WAIT_END()
+
+#endif // FEATURE_PROFILING
+
+#endif // PROFILE_H__
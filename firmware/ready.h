@@ -0,0 +1,84 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Ready line (FEATURE_READY)
+ *
+ * An open drain output the host waits on instead of sleeping for fixed
+ * delays or polling over the bus. The host pulls it up.
+ *  - every received byte releases the line
+ *  - it is pulled low when the commands have been executed down to
+ *    READY_LOW_WATER bytes still waiting in the receive buffers, and the
+ *    EEPROM is done programming. CGRAM is written by then as well, the
+ *    bitmaps of 0x9f and the glyph commands go straight to the LCD.
+ *
+ * With READY_LOW_WATER 0 a low line after a write means that everything
+ * sent so far has been executed, with a higher mark that there is room
+ * for more. A host on I2C can look at the line as soon as its transmission
+ * ended, the bytes have been taken by then. A UART host has to allow for
+ * the bytes still on the wire.
+ *
+ * The line is pin READY_PIN of port READY_PORT, PB6 by default. That pin
+ * is free on both boards, but with LCD_8BIT_MODE it is LCD D6 and the
+ * build stops; PA1 is free there (READY_PORT=A READY_PIN=1), the clock
+ * comes from the internal oscillator.
+ */
+
+#ifndef READY_H__
+#define READY_H__
+
+#ifdef FEATURE_READY
+
+#include <avr/io.h>
+
+#ifndef READY_PORT
+#define READY_PORT              B
+#endif
+#ifndef READY_PIN
+#define READY_PIN               6
+#endif
+#ifndef READY_LOW_WATER
+#define READY_LOW_WATER         0
+#endif
+
+#define READY_CONCAT(a, b)      a ## b
+#define READY_REGISTER(a, b)    READY_CONCAT(a, b)
+#define READY_DDR               READY_REGISTER(DDR, READY_PORT)
+
+/* LCD_8BIT_MODE has data lines on PA0, PB0, PB3 and PB6 (see lcd.h) */
+#define READY_PORT_A            1
+#define READY_PORT_B            2
+#define READY_PORT_D            3
+#define READY_PORT_ID           READY_REGISTER(READY_PORT_, READY_PORT)
+
+#if defined(LCD_8BIT_MODE) && \
+	((READY_PORT_ID == READY_PORT_A && READY_PIN == 0) || \
+	 (READY_PORT_ID == READY_PORT_B && (READY_PIN == 0 || READY_PIN == 3 || READY_PIN == 6)))
+#error "READY_PIN is an LCD data line in LCD_8BIT_MODE, use another pin such as PA1"
+#endif
+
+/* the PORT bit is left at 0, the pin drives the line low as an output */
+#define ready_release()         (READY_DDR &= ~_BV(READY_PIN))
+#define ready_assert()          (READY_DDR |= _BV(READY_PIN))
+
+void ready_update(void);
+
+#else
+
+#define ready_release()
+
+#endif // FEATURE_READY
+
+#endif // READY_H__
@@ -0,0 +1,127 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_REGISTERS
+
+#include <avr/io.h>
+
+#include "regs.h"
+#include "lcd.h"
+#include "usiTwiSlave.h"
+
+static bool active;
+static uint8_t pointer;             // register of the next byte
+static uint8_t ac;
+static bool ac_valid;               // the LCD address counter is at ac
+static uint8_t glyph[8];            // rows of a character until the last one is written
+
+// Point the LCD address counter at the register pointer. A write goes
+// on from the last byte if the counter is already there, a read always
+// sets the address: after a write the LCD returns stale data until then.
+// Returns false for registers that are not LCD memory.
+static bool regs_seek(bool read)
+{
+	if (!read && ac_valid && ac == pointer)
+		return true;
+
+	if (pointer < REGS_CGRAM) {
+		if (pointer >= lcd_disp_length * lcd_lines)
+			return false;
+		if (read)
+			lcd_seek(pointer % lcd_disp_length, pointer / lcd_disp_length);
+		else
+			lcd_gotoxy(pointer % lcd_disp_length, pointer / lcd_disp_length);
+	} else if (pointer < REGS_CGRAM_END) {
+		lcd_gotoxy(0, 0); // the first controller of a 4x40 display
+		lcd_command(_BV(LCD_CGRAM) | (pointer - REGS_CGRAM));
+	} else
+		return false;
+
+	ac = pointer;
+	ac_valid = true;
+	return true;
+}
+
+// The LCD has advanced its address counter after a read or write
+static void regs_step(void)
+{
+	ac++;
+	if (ac < REGS_CGRAM && ac % lcd_span_length == 0)
+		ac_valid = false; // the next row or half row does not follow in DDRAM
+}
+
+static void regs_write(uint8_t data)
+{
+	if (pointer < REGS_CGRAM) {
+		if (regs_seek(false)) {
+			lcd_putraw(data);
+			regs_step();
+		}
+	} else if (pointer < REGS_CGRAM_END) {
+		glyph[pointer & 7] = data;
+		if ((pointer & 7) == 7) {
+			lcd_createCharacter((pointer - REGS_CGRAM) >> 3, glyph);
+			ac_valid = false;
+		}
+	} else if (pointer == REGS_CONTROL && data == 0)
+		active = false;
+
+	pointer++;
+}
+
+static uint8_t regs_read(void)
+{
+	uint8_t data = 0xff;
+
+	if (pointer < REGS_CGRAM_END) {
+#ifndef LCD_WRITE_ONLY
+		if (regs_seek(true)) {
+			data = lcd_getc();
+			regs_step();
+		}
+#endif
+	} else if (pointer == REGS_CONTROL)
+		data = 1;
+	else if (pointer == REGS_COLUMNS)
+		data = lcd_disp_length;
+	else if (pointer == REGS_ROWS)
+		data = lcd_lines;
+
+	pointer++;
+	return data;
+}
+
+// Serve register transactions until 0 is written to the control register
+void regs_run(void)
+{
+	active = true;
+	ac_valid = false;
+
+	while (active) {
+		if (usiTwiRxPending()) {
+			if (usiTwiFirstByte())
+				pointer = usiTwiReceiveByte();
+			else
+				regs_write(usiTwiReceiveByte());
+		} else if (usiTwiReadWaiting())
+			usiTwiTransmitByte(regs_read());
+		else
+			USI_TWI_WAIT();
+	}
+
+	lcd_gotoxy(0, 0);
+}
+
+#endif // FEATURE_REGISTERS
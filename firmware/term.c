@@ -0,0 +1,208 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_TERMINAL
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#include "term.h"
+#include "window.h"
+#include "lcd.h"
+
+#define ESC             0x1b
+
+enum { TERM_TEXT, TERM_ESC, TERM_CSI };
+
+static bool active;
+static uint8_t state;
+static uint8_t param[TERM_PARAMS];
+static uint8_t params;              // index of the parameter being read
+static bool private;                // CSI ? sequence
+static uint8_t cursor;              // TERM_ flags
+static uint8_t saved_x, saved_y;
+
+void term_mode(uint8_t on)
+{
+	active = on;
+	state = TERM_TEXT;
+	if (on)
+		window_set(lcd_lines - 1, 0, lcd_disp_length - 1, WINDOW_WRAP);
+	else
+		window_leave();
+}
+
+bool term_active(void)
+{
+	return active;
+}
+
+static void term_save(void)
+{
+	saved_x = window_x();
+	saved_y = window_y();
+}
+
+static void term_restore(void)
+{
+	window_goto(saved_x, saved_y);
+}
+
+static void term_clear(void)
+{
+	lcd_clrscr();
+	window_moved();
+}
+
+// First parameter, <def> when it is missing or 0
+static uint8_t term_param(uint8_t def)
+{
+	return param[0] ? param[0] : def;
+}
+
+static void term_csi(char c)
+{
+	uint8_t x = window_x();
+	uint8_t y = window_y();
+	uint8_t i;
+
+	switch (c) {
+		case 'H':
+		case 'f':
+			window_goto(param[1] ? param[1] - 1 : 0, term_param(1) - 1);
+			break;
+		case 'A':
+			window_goto(x, y > term_param(1) ? y - term_param(1) : 0);
+			break;
+		case 'B':
+			window_goto(x, y + term_param(1));
+			break;
+		case 'C':
+			window_goto(x + term_param(1), y);
+			break;
+		case 'D':
+			window_goto(x > term_param(1) ? x - term_param(1) : 0, y);
+			break;
+		case 'K':
+			if (param[0] == 0)
+				lcd_fill(x, y, 0xff, y, ' ');
+			else if (param[0] == 1)
+				lcd_fill(0, y, x, y, ' ');
+			else
+				lcd_fill(0, y, 0xff, y, ' ');
+			break;
+		case 'J':
+			if (param[0] == 0) {
+				lcd_fill(x, y, 0xff, y, ' ');
+				lcd_fill(0, y + 1, 0xff, 0xff, ' ');
+			} else if (param[0] == 1) {
+				if (y > 0)
+					lcd_fill(0, 0, 0xff, y - 1, ' ');
+				lcd_fill(0, y, x, y, ' ');
+			} else {
+				term_clear();
+			}
+			break;
+		case 's':
+			term_save();
+			break;
+		case 'u':
+			term_restore();
+			break;
+		case 'm':
+			for (i = 0; i <= params && i < TERM_PARAMS; i++) {
+				if (param[i] == 5)
+					cursor |= TERM_BLINK;
+				else if (param[i] == 0 || param[i] == 25)
+					cursor &= ~TERM_BLINK;
+			}
+			term_cursor(cursor);
+			break;
+		case 'h':
+		case 'l':
+			if (private && param[0] == 25) {
+				if (c == 'h')
+					cursor |= TERM_CURSOR;
+				else
+					cursor &= ~TERM_CURSOR;
+				term_cursor(cursor);
+			}
+			break;
+	}
+}
+
+void term_putc(char c)
+{
+	uint8_t x;
+
+	switch (state) {
+		case TERM_ESC:
+			state = TERM_TEXT;
+			if (c == '[') {
+				state = TERM_CSI;
+				param[0] = param[1] = 0;
+				params = 0;
+				private = false;
+			} else if (c == '7') {
+				term_save();
+			} else if (c == '8') {
+				term_restore();
+			} else if (c == 'c') {
+				term_clear();
+				window_goto(0, 0);
+			}
+			return;
+
+		case TERM_CSI:
+			if (c >= '0' && c <= '9') {
+				if (params < TERM_PARAMS && param[params] < 25)
+					param[params] = param[params] * 10 + c - '0';
+			} else if (c == ';') {
+				params++;
+			} else if (c == '?') {
+				private = true;
+			} else if (c >= 0x40 && c <= 0x7e) {
+				state = TERM_TEXT;
+				term_csi(c);
+			}
+			return;
+	}
+
+	x = window_x();
+	switch (c) {
+		case ESC:
+			state = TERM_ESC;
+			break;
+		case '\r':
+			window_goto(0, window_y());
+			break;
+		case '\n':
+			window_putc('\n');
+			break;
+		case '\b':
+			if (x > 0)
+				window_goto(x - 1, window_y());
+			break;
+		case '\t':
+			window_goto((x + 8) & ~7, window_y());
+			break;
+		default:
+			if (c >= ' ')
+				window_putc(c);
+			break;
+	}
+}
+
+#endif // FEATURE_TERMINAL
@@ -0,0 +1,96 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_UART
+
+#include <stdbool.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#include "uart.h"
+#include "input.h"
+#include "ready.h"
+
+static volatile uint8_t rx_buffer[UART_RX_BUFFER_SIZE];
+static volatile uint8_t rx_head;
+static volatile uint8_t rx_tail;
+
+bool input_uart;                    // the command being processed came in on the UART
+
+void uart_init(void)
+{
+	UBRRH = UART_UBRR >> 8;
+	UBRRL = UART_UBRR;
+	UCSRA = _BV(U2X);
+	UCSRC = _BV(UCSZ1) | _BV(UCSZ0); // 8N1
+	UCSRB = _BV(RXCIE) | _BV(RXEN) | _BV(TXEN);
+}
+
+ISR(USART_RX_vect)
+{
+	uint8_t data = UDR;
+	uint8_t head = (rx_head + 1) & UART_RX_BUFFER_MASK;
+
+	if (head == rx_tail)
+		return; // full, the byte is lost
+	rx_buffer[head] = data;
+	rx_head = head;
+	ready_release();
+}
+
+bool uart_available(void)
+{
+	return rx_head != rx_tail;
+}
+
+#ifdef FEATURE_READY
+uint8_t uart_level(void)
+{
+	return (rx_head - rx_tail) & UART_RX_BUFFER_MASK;
+}
+#endif
+
+uint8_t uart_receiveByte(void)
+{
+	uint8_t tail;
+
+	while (rx_head == rx_tail)
+		UART_WAIT();
+	tail = (rx_tail + 1) & UART_RX_BUFFER_MASK;
+	rx_tail = tail;
+	return rx_buffer[tail];
+}
+
+void uart_transmitByte(uint8_t data)
+{
+	while (!(UCSRA & _BV(UDRE)))
+		;
+	UDR = data;
+}
+
+// Pick the transport of the next command, false when neither has data
+bool input_select(void)
+{
+	bool twi = usiTwiDataInReceiveBuffer();
+	bool uart = uart_available();
+
+	if (twi && uart)
+		input_uart = !input_uart; // take turns
+	else if (twi || uart)
+		input_uart = uart;
+	return twi || uart;
+}
+
+#endif // FEATURE_UART
@@ -43,6 +43,7 @@ Change Activity:
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include "usiTwiSlave.h"
+#include "ready.h"
 
 
 
@@ -256,10 +257,52 @@ static uint8_t          rxBuf[ TWI_RX_BUFFER_SIZE ];
 static volatile uint8_t rxHead;
 static volatile uint8_t rxTail;
 
+#ifdef FEATURE_PROFILING
+volatile uint32_t       usiTwiRxCount;
+volatile uint16_t       usiTwiRxStalls;
+#endif
+
 static uint8_t          txBuf[ TWI_TX_BUFFER_SIZE ];
 static volatile uint8_t txHead;
 static volatile uint8_t txTail;
 
+// Flow control: when the master writes into a full receive buffer or reads
+// from an empty transmit buffer, the overflow ISR disables itself and leaves
+// its flag set, so the USI keeps SCL low (clock stretching) until the main
+// program has made room or queued the reply.
+
+#define USI_STALL_NONE  0
+#define USI_STALL_RX    1       // rxStalledByte waits for room in rxBuf
+#define USI_STALL_TX    2       // the master waits for a byte in txBuf
+
+static volatile uint8_t stalled;
+static uint8_t          rxStalledByte;
+
+#ifdef FEATURE_REGISTERS
+
+// one bit for each slot of rxBuf, set when the slot holds the first byte the
+// master wrote after the slave address
+
+#if ( TWI_RX_BUFFER_SIZE > 16 )
+#  error TWI RX buffer too large for the first byte bitmap
+#endif
+
+static volatile bool     rxStart;       // the next byte received starts a write
+static volatile uint16_t rxFirst;
+
+#define USI_MARK_FIRST( slot ) \
+{ \
+  if ( rxStart ) \
+    rxFirst |= ( 1u << ( slot ) ); \
+  else \
+    rxFirst &= ~( 1u << ( slot ) ); \
+  rxStart = false; \
+}
+
+#else
+#  define USI_MARK_FIRST( slot )
+#endif
+
 
 
 /********************************************************************************
@@ -270,6 +313,66 @@ static volatile uint8_t txTail;
 
 
 
+// hold SCL low until usiTwiResume( ) or usiTwiRelease( ), called from the
+// overflow ISR
+
+#define USI_STALL( reason ) \
+{ \
+  stalled = ( reason ); \
+  USICR &= ~( 1 << USIOIE ); \
+}
+
+
+
+// continue a transfer held by USI_STALL( ) now that there is room in rxBuf
+// or data in txBuf; the overflow interrupt is disabled, so this cannot race
+// with the ISR, and no start condition can occur while SCL is low
+
+static void
+usiTwiResume(
+  void
+)
+{
+
+  if ( stalled == USI_STALL_RX )
+  {
+    rxHead = ( rxHead + 1 ) & TWI_RX_BUFFER_MASK;
+    rxBuf[ rxHead ] = rxStalledByte;
+    USI_MARK_FIRST( rxHead );
+    overflowState = USI_SLAVE_REQUEST_DATA;
+    SET_USI_TO_SEND_ACK( );
+  }
+  else
+  {
+    txTail = ( txTail + 1 ) & TWI_TX_BUFFER_MASK;
+    USIDR = txBuf[ txTail ];
+    overflowState = USI_SLAVE_REQUEST_REPLY_FROM_SEND_DATA;
+    SET_USI_TO_SEND_DATA( );
+  }
+  stalled = USI_STALL_NONE;
+  USICR |= ( 1 << USIOIE );
+
+} // end usiTwiResume
+
+
+
+// give up a read the main program has no reply for: the master reads 0xFF
+// and the USI waits for the next start condition
+
+static void
+usiTwiRelease(
+  void
+)
+{
+
+  stalled = USI_STALL_NONE;
+  DDR_USI &= ~( 1 << PORT_USI_SDA );
+  SET_USI_TO_TWI_START_CONDITION_MODE( );
+
+} // end usiTwiRelease
+
+
+
 // flushes the TWI buffers
 
 void
@@ -283,6 +386,10 @@ flushTwiBuffers(
   rxHead = 0;
   txTail = 0;
   txHead = 0;
+  if ( stalled == USI_STALL_RX )
+    usiTwiResume( );
+  else if ( stalled == USI_STALL_TX )
+    usiTwiRelease( );
   sei();
 } // end flushTwiBuffers
 
@@ -360,7 +467,7 @@ usiTwiTransmitByte(
   tmphead = ( txHead + 1 ) & TWI_TX_BUFFER_MASK;
 
   // wait for free space in buffer
-  while ( tmphead == txTail );
+  while ( tmphead == txTail ) USI_TWI_WAIT( );
 
   // store data in buffer
   txBuf[ tmphead ] = data;
@@ -368,6 +475,10 @@ usiTwiTransmitByte(
   // store new index
   txHead = tmphead;
 
+  // the master is already waiting for it
+  if ( stalled == USI_STALL_TX )
+    usiTwiResume( );
+
 } // end usiTwiTransmitByte
 
 
@@ -380,14 +491,28 @@ usiTwiReceiveByte(
 )
 {
 
+  uint8_t data;
+
   // wait for Rx data
-  while ( rxHead == rxTail );
+  while ( rxHead == rxTail )
+  {
+    // the reply to a read can only come from a command still to be received
+    if ( stalled == USI_STALL_TX )
+      usiTwiRelease( );
+    USI_TWI_WAIT( );
+  }
 
   // calculate buffer index
   rxTail = ( rxTail + 1 ) & TWI_RX_BUFFER_MASK;
 
-  // return data from the buffer.
-  return rxBuf[ rxTail ];
+  // get data from the buffer
+  data = rxBuf[ rxTail ];
+
+  // there is room again for the byte the master is held on
+  if ( stalled == USI_STALL_RX )
+    usiTwiResume( );
+
+  return data;
 
 } // end usiTwiReceiveByte
 
@@ -401,13 +526,86 @@ usiTwiDataInReceiveBuffer(
 )
 {
 
+  if ( rxHead != rxTail )
+    return true;
+
+  // all commands are done, no reply is coming for a read that is held
+  if ( stalled == USI_STALL_TX )
+    usiTwiRelease( );
+
   // return 0 (false) if the receive buffer is empty
-  return rxHead != rxTail;
+  return false;
 
 } // end usiTwiDataInReceiveBuffer
 
 
 
+#ifdef FEATURE_READY
+
+// number of bytes waiting in the receive buffer
+
+uint8_t
+usiTwiAmountDataInReceiveBuffer(
+  void
+)
+{
+
+  return ( rxHead - rxTail ) & TWI_RX_BUFFER_MASK;
+
+} // end usiTwiAmountDataInReceiveBuffer
+
+#endif
+
+
+
+#ifdef FEATURE_REGISTERS
+
+// check if there is data in the receive buffer, unlike
+// usiTwiDataInReceiveBuffer( ) a read that is held is kept waiting
+
+bool
+usiTwiRxPending(
+  void
+)
+{
+
+  return rxHead != rxTail;
+
+} // end usiTwiRxPending
+
+
+
+// check if the master is held on a read until a byte is transmitted
+
+bool
+usiTwiReadWaiting(
+  void
+)
+{
+
+  return stalled == USI_STALL_TX;
+
+} // end usiTwiReadWaiting
+
+
+
+// check if the next byte in the receive buffer is the first byte of a write
+// transaction
+
+bool
+usiTwiFirstByte(
+  void
+)
+{
+
+  return ( rxFirst & ( 1u << ( ( rxTail + 1 ) & TWI_RX_BUFFER_MASK ) ) ) != 0;
+
+} // end usiTwiFirstByte
+
+#endif
+
+
+
 /********************************************************************************
 
                             USI Start Condition ISR
@@ -514,6 +712,9 @@ ISR( USI_OVERFLOW_VECTOR )
         else
         {
           overflowState = USI_SLAVE_REQUEST_DATA;
+#ifdef FEATURE_REGISTERS
+          rxStart = true;
+#endif
         } // end if
         SET_USI_TO_SEND_ACK( );
       }
@@ -546,8 +747,8 @@ ISR( USI_OVERFLOW_VECTOR )
       }
       else
       {
-        // the buffer is empty
-        SET_USI_TO_TWI_START_CONDITION_MODE( );
+        // the buffer is empty: hold the master until the reply is queued
+        USI_STALL( USI_STALL_TX );
         return;
       } // end if
       overflowState = USI_SLAVE_REQUEST_REPLY_FROM_SEND_DATA;
@@ -571,10 +772,26 @@ ISR( USI_OVERFLOW_VECTOR )
     // copy data from USIDR and send ACK
     // next USI_SLAVE_REQUEST_DATA
     case USI_SLAVE_GET_DATA_AND_SEND_ACK:
+      // the host waits for the line to go low again
+      ready_release( );
+#ifdef FEATURE_PROFILING
+      usiTwiRxCount++;
+#endif
+      if ( ( ( rxHead + 1 ) & TWI_RX_BUFFER_MASK ) == rxTail )
+      {
+        // the buffer is full: hold the master until there is room
+        rxStalledByte = USIDR;
+#ifdef FEATURE_PROFILING
+        usiTwiRxStalls++;
+#endif
+        USI_STALL( USI_STALL_RX );
+        break;
+      }
       // put data into buffer
       // Not necessary, but prevents warnings
       rxHead = ( rxHead + 1 ) & TWI_RX_BUFFER_MASK;
       rxBuf[ rxHead ] = USIDR;
+      USI_MARK_FIRST( rxHead );
       // next USI_SLAVE_REQUEST_DATA
       overflowState = USI_SLAVE_REQUEST_DATA;
       SET_USI_TO_SEND_ACK( );
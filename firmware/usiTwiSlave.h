@@ -59,6 +59,27 @@ bool    usiTwiDataInReceiveBuffer( void );
 
 void flushTwiBuffers( void );
 
+#ifdef FEATURE_REGISTERS
+bool    usiTwiRxPending( void );
+bool    usiTwiReadWaiting( void );
+bool    usiTwiFirstByte( void );
+#endif
+
+#ifdef FEATURE_READY
+uint8_t usiTwiAmountDataInReceiveBuffer( void );
+#endif
+
+#ifdef FEATURE_PROFILING
+extern volatile uint32_t usiTwiRxCount;     // bytes received
+extern volatile uint16_t usiTwiRxStalls;    // times the master was held on a full buffer
+#endif
+
+// called while waiting for the bus (buffer empty or full); does nothing on
+// the target, the host simulator uses it to deliver the next bus events
+#ifndef USI_TWI_WAIT
+#  define USI_TWI_WAIT( )
+#endif
+
 
 /********************************************************************************
 
@@ -0,0 +1,193 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_UTF8
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+
+#include "utf8.h"
+#include "lcd.h"
+
+#define UTF8_UNKNOWN    '?'
+#define UTF8_INVALID    0xffff      // code point of a malformed or 4 byte sequence
+
+#define KANA_DAKUTEN    0x40        // followed by the voiced sound mark 0xde
+#define KANA_HANDAKUTEN 0x80        // followed by the semi-voiced sound mark 0xdf
+#define KANA(code)      ((code) - 0xa0)
+
+// U+30A1-U+30F6, full width katakana as half width ROM codes
+static const PROGMEM uint8_t katakana[] =
+{
+	KANA(0xa7), KANA(0xb1), KANA(0xa8), KANA(0xb2), KANA(0xa9), KANA(0xb3),      // ァアィイゥウ
+	KANA(0xaa), KANA(0xb4), KANA(0xab), KANA(0xb5),                              // ェエォオ
+	KANA(0xb6), KANA(0xb6) | KANA_DAKUTEN, KANA(0xb7), KANA(0xb7) | KANA_DAKUTEN, // カガキギ
+	KANA(0xb8), KANA(0xb8) | KANA_DAKUTEN, KANA(0xb9), KANA(0xb9) | KANA_DAKUTEN, // クグケゲ
+	KANA(0xba), KANA(0xba) | KANA_DAKUTEN, KANA(0xbb), KANA(0xbb) | KANA_DAKUTEN, // コゴサザ
+	KANA(0xbc), KANA(0xbc) | KANA_DAKUTEN, KANA(0xbd), KANA(0xbd) | KANA_DAKUTEN, // シジスズ
+	KANA(0xbe), KANA(0xbe) | KANA_DAKUTEN, KANA(0xbf), KANA(0xbf) | KANA_DAKUTEN, // セゼソゾ
+	KANA(0xc0), KANA(0xc0) | KANA_DAKUTEN, KANA(0xc1), KANA(0xc1) | KANA_DAKUTEN, // タダチヂ
+	KANA(0xaf), KANA(0xc2), KANA(0xc2) | KANA_DAKUTEN,                           // ッツヅ
+	KANA(0xc3), KANA(0xc3) | KANA_DAKUTEN, KANA(0xc4), KANA(0xc4) | KANA_DAKUTEN, // テデトド
+	KANA(0xc5), KANA(0xc6), KANA(0xc7), KANA(0xc8), KANA(0xc9),                  // ナニヌネノ
+	KANA(0xca), KANA(0xca) | KANA_DAKUTEN, KANA(0xca) | KANA_HANDAKUTEN,         // ハバパ
+	KANA(0xcb), KANA(0xcb) | KANA_DAKUTEN, KANA(0xcb) | KANA_HANDAKUTEN,         // ヒビピ
+	KANA(0xcc), KANA(0xcc) | KANA_DAKUTEN, KANA(0xcc) | KANA_HANDAKUTEN,         // フブプ
+	KANA(0xcd), KANA(0xcd) | KANA_DAKUTEN, KANA(0xcd) | KANA_HANDAKUTEN,         // ヘベペ
+	KANA(0xce), KANA(0xce) | KANA_DAKUTEN, KANA(0xce) | KANA_HANDAKUTEN,         // ホボポ
+	KANA(0xcf), KANA(0xd0), KANA(0xd1), KANA(0xd2), KANA(0xd3),                  // マミムメモ
+	KANA(0xac), KANA(0xd4), KANA(0xad), KANA(0xd5), KANA(0xae), KANA(0xd6),      // ャヤュユョヨ
+	KANA(0xd7), KANA(0xd8), KANA(0xd9), KANA(0xda), KANA(0xdb),                  // ラリルレロ
+	KANA(0xdc), KANA(0xdc), KANA(0xb2), KANA(0xb4), KANA(0xa6), KANA(0xdd),      // ヮワヰヱヲン
+	KANA(0xb3) | KANA_DAKUTEN, KANA(0xb6), KANA(0xb9)                            // ヴヵヶ
+};
+
+struct utf8_symbol {
+	uint16_t cp;
+	uint8_t code;
+};
+
+// symbols of ROM A00 outside ASCII and katakana
+static const PROGMEM struct utf8_symbol symbols_a00[] =
+{
+	{ 0x00a2, 0xec },   // ¢
+	{ 0x00a5, 0x5c },   // ¥
+	{ 0x00b0, 0xdf },   // °
+	{ 0x00b5, 0xe4 },   // µ
+	{ 0x00e4, 0xe1 },   // ä
+	{ 0x00f1, 0xee },   // ñ
+	{ 0x00f6, 0xef },   // ö
+	{ 0x00f7, 0xfd },   // ÷
+	{ 0x00fc, 0xf5 },   // ü
+	{ 0x03a3, 0xf6 },   // Σ
+	{ 0x03a9, 0xf4 },   // Ω
+	{ 0x03b1, 0xe0 },   // α
+	{ 0x03b2, 0xe2 },   // β
+	{ 0x03b5, 0xe3 },   // ε
+	{ 0x03b8, 0xf2 },   // θ
+	{ 0x03bc, 0xe4 },   // μ
+	{ 0x03c0, 0xf7 },   // π
+	{ 0x03c1, 0xe6 },   // ρ
+	{ 0x03c3, 0xe5 },   // σ
+	{ 0x2190, 0x7f },   // ←
+	{ 0x2192, 0x7e },   // →
+	{ 0x221a, 0xe8 },   // √
+	{ 0x221e, 0xf3 },   // ∞
+	{ 0x2588, 0xff },   // █
+	{ 0x3001, 0xa4 },   // 、
+	{ 0x3002, 0xa1 },   // 。
+	{ 0x300c, 0xa2 },   // 「
+	{ 0x300d, 0xa3 },   // 」
+	{ 0x309b, 0xde },   // ゛
+	{ 0x309c, 0xdf },   // ゜
+	{ 0x30fb, 0xa5 },   // ・
+	{ 0x30fc, 0xb0 },   // ー
+	{ 0x4e07, 0xfb },   // 万
+	{ 0x5343, 0xfa },   // 千
+	{ 0x5186, 0xfc },   // 円
+};
+
+static uint8_t rom;
+static uint16_t cp;                 // code point being decoded
+static uint8_t more;                // continuation bytes still expected
+
+void utf8_rom(uint8_t r)
+{
+	rom = r;
+}
+
+// Show one code point on ROM A00
+static void utf8_a00(uint16_t c)
+{
+	uint8_t i, k;
+
+	if (c >= 0x3041 && c <= 0x3096)
+		c += 0x60; // hiragana as katakana
+
+	if (c >= 0x30a1 && c <= 0x30f6) {
+		k = pgm_read_byte(&katakana[c - 0x30a1]);
+		lcd_putc(0xa0 + (k & 0x3f));
+		if (k & KANA_DAKUTEN)
+			lcd_putc(0xde);
+		else if (k & KANA_HANDAKUTEN)
+			lcd_putc(0xdf);
+		return;
+	}
+
+	if (c >= 0xff61 && c <= 0xff9f) {
+		lcd_putc(c - 0xff61 + 0xa1); // half width katakana, in ROM order
+		return;
+	}
+
+	for (i = 0; i < sizeof(symbols_a00) / sizeof(symbols_a00[0]); i++) {
+		if (pgm_read_word(&symbols_a00[i].cp) == c) {
+			lcd_putc(pgm_read_byte(&symbols_a00[i].code));
+			return;
+		}
+	}
+	lcd_putc(UTF8_UNKNOWN);
+}
+
+static void utf8_show(uint16_t c)
+{
+	if (c < 0x80)
+		lcd_putc(c);
+	else if (rom == UTF8_ROM_A00)
+		utf8_a00(c);
+	else if (rom == UTF8_ROM_A02 && c >= 0xa0 && c <= 0xff)
+		lcd_putc(c);
+	else
+		lcd_putc(UTF8_UNKNOWN);
+}
+
+// Drop a character that has not been sent in full
+void utf8_reset(void)
+{
+	more = 0;
+}
+
+// Decode one byte of UTF-8 text
+void utf8_putc(uint8_t b)
+{
+	if (b < 0x80 || b >= 0xc0) {
+		if (more)
+			lcd_putc(UTF8_UNKNOWN); // the last sequence was cut short
+		more = 0;
+	}
+
+	if (b < 0x80) {
+		utf8_show(b);
+	} else if (b < 0xc0) {
+		if (!more) {
+			lcd_putc(UTF8_UNKNOWN); // stray continuation byte
+			return;
+		}
+		if (cp != UTF8_INVALID)
+			cp = (cp << 6) | (b & 0x3f);
+		if (--more == 0)
+			utf8_show(cp);
+	} else if (b < 0xe0) {
+		cp = b & 0x1f;
+		more = 1;
+	} else if (b < 0xf0) {
+		cp = b & 0x0f;
+		more = 2;
+	} else {
+		cp = UTF8_INVALID; // outside the 16 bit range, no display has it
+		more = 3;
+	}
+}
+
+#endif // FEATURE_UTF8
@@ -0,0 +1,53 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * UTF-8 text (FEATURE_UTF8)
+ *
+ * Bytes from 0x80 up are commands, so UTF-8 text is sent with a length:
+ *
+ *   0xe9 <length> <length bytes of UTF-8>
+ *
+ * The text is decoded and translated to the character ROM of the display,
+ * selected with 0xe8 <rom>:
+ *
+ *   0  A00, Japanese (default): half and full width katakana (voiced ones
+ *      become two characters, hiragana is shown as katakana), Japanese
+ *      punctuation, the Greek letters and symbols of the ROM, and ¥ → ←
+ *   1  A02, European: Latin-1 (U+00A0-U+00FF)
+ *
+ * ASCII is passed on unchanged, U+0000-U+0007 are the user characters and
+ * '\n' starts a new line as with plain text. Characters the ROM does not
+ * have and malformed sequences are shown as '?'. A character may be split
+ * over several 0xe9 commands, reset (0xfe) drops one that is not complete.
+ */
+
+#ifndef UTF8_H__
+#define UTF8_H__
+
+#ifdef FEATURE_UTF8
+
+#include <avr/io.h>
+
+#define UTF8_ROM_A00    0
+#define UTF8_ROM_A02    1
+
+void utf8_rom(uint8_t rom);
+void utf8_putc(uint8_t b);
+void utf8_reset(void);
+
+#endif // FEATURE_UTF8
+
+#endif // UTF8_H__
@@ -0,0 +1,165 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+#ifdef FEATURE_WINDOWS
+
+#include <stdbool.h>
+#include <avr/io.h>
+
+#include "window.h"
+#include "lcd.h"
+
+#define WINDOW_CHUNK    10          // characters moved at a time when scrolling
+
+static bool defined;
+static bool active;
+static bool placed;                 // the LCD cursor is at the window cursor
+static uint8_t wrap;
+static uint8_t left, right, top, bottom;
+static uint8_t x, y;                // window cursor, in screen coordinates
+
+void window_set(uint8_t lines, uint8_t first, uint8_t last, uint8_t mode)
+{
+	top = lines >> 4;
+	bottom = lines & 0x0f;
+	if (bottom >= lcd_lines)
+		bottom = lcd_lines - 1;
+	if (last >= lcd_disp_length)
+		last = lcd_disp_length - 1;
+
+	defined = top <= bottom && first <= last;
+	left = first;
+	right = last;
+	wrap = mode & WINDOW_WRAP;
+	x = left;
+	y = top;
+	window_enter();
+}
+
+void window_enter(void)
+{
+	active = defined;
+	placed = false;
+}
+
+void window_leave(void)
+{
+	active = false;
+}
+
+// Forget the window, 0xb2 has nothing to go back to
+void window_reset(void)
+{
+	defined = false;
+	active = false;
+}
+
+void window_clear(void)
+{
+	if (!defined)
+		return;
+	lcd_fill(left, top, right, bottom, ' ');
+	x = left;
+	y = top;
+	placed = false;
+}
+
+// Window cursor, relative to the top left of the window
+uint8_t window_x(void)
+{
+	return x - left;
+}
+
+uint8_t window_y(void)
+{
+	return y - top;
+}
+
+// Move the window cursor, clipped to the window
+void window_goto(uint8_t col, uint8_t row)
+{
+	if (!active)
+		return;
+	x = col > right - left ? right : left + col;
+	y = row > bottom - top ? bottom : top + row;
+	lcd_gotoxy(x, y);
+	placed = true;
+}
+
+// A command may have moved the LCD cursor
+void window_moved(void)
+{
+	placed = false;
+}
+
+// Move the lines of the window up by one, the LCD is the shadow copy
+static void window_scroll(void)
+{
+	uint8_t buffer[WINDOW_CHUNK];
+	uint8_t row, col, n, i;
+
+	for (row = top; row < bottom; row++) {
+		for (col = left; col <= right; col += n) {
+			n = right - col + 1;
+			if (n > WINDOW_CHUNK)
+				n = WINDOW_CHUNK;
+			lcd_seek(col, row + 1);
+			for (i = 0; i < n; i++)
+				buffer[i] = lcd_getc();
+			lcd_gotoxy(col, row);
+			for (i = 0; i < n; i++)
+				lcd_putraw(buffer[i]);
+		}
+	}
+	lcd_fill(left, bottom, right, bottom, ' ');
+}
+
+static void window_newline(void)
+{
+	x = left;
+	if (y < bottom)
+		y++;
+	else
+		window_scroll();
+	placed = false;
+}
+
+void window_putc(char c)
+{
+	if (!active) {
+		lcd_putc(c);
+		return;
+	}
+
+	if (c == '\n') {
+		window_newline();
+		return;
+	}
+	if (x > right) {
+		if (!wrap)
+			return; // cut at the right edge
+		window_newline();
+	}
+
+	if (!placed) {
+		lcd_gotoxy(x, y);
+		placed = true;
+	}
+	lcd_putraw(c);
+	if (++x == lcd_span_length)
+		placed = false; // a split line continues elsewhere in DDRAM
+}
+
+#endif // FEATURE_WINDOWS
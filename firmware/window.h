@@ -0,0 +1,62 @@
+/*
+ * TWI LCD Character Display
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Text window (FEATURE_WINDOWS)
+ *
+ *   0xb0 <lines> <first column> <last column> <mode>
+ *               text goes to a window, lines holds the first line in the
+ *               high nibble and the last line in the low nibble as for
+ *               0xa8. Mode WINDOW_WRAP wraps long lines, otherwise they
+ *               are cut at the right edge. The cursor starts at the top
+ *               left of the window.
+ *   0xb1        text goes to the cursor again
+ *   0xb2        text goes to the window again, after its last character
+ *   0xb3        clear the window, its cursor goes to the top left
+ *
+ * Text (plain and with 0xa2/0xa4) never leaves the window. A new line at
+ * the bottom scrolls the window up by one line, the lines are read back
+ * from the LCD, so windows are not available with LCD_WRITE_ONLY. Other
+ * commands can be used while a window is active, they do not move its
+ * cursor. Reset (0xfe) removes the window.
+ */
+
+#ifndef WINDOW_H__
+#define WINDOW_H__
+
+#ifdef FEATURE_WINDOWS
+
+#include <avr/io.h>
+
+#ifdef LCD_WRITE_ONLY
+#error "FEATURE_WINDOWS reads the screen from the LCD, it does not work with LCD_WRITE_ONLY"
+#endif
+
+#define WINDOW_WRAP     0x01
+
+void window_set(uint8_t lines, uint8_t first, uint8_t last, uint8_t mode);
+void window_enter(void);
+void window_leave(void);
+void window_reset(void);
+void window_clear(void);
+void window_moved(void);
+uint8_t window_x(void);
+uint8_t window_y(void);
+void window_goto(uint8_t col, uint8_t row);
+void window_putc(char c);
+
+#endif // FEATURE_WINDOWS
+
+#endif // WINDOW_H__
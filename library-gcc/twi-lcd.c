@@ -20,206 +20,589 @@
 #include "twi.h"
 #include "twi-lcd.h"
 
+// Capabilities and error counts of the displays set up with lcd_init()
+static struct lcd_device {
+	uint8_t addr;
+	bool framed;
+	struct lcd_caps caps;
+	struct lcd_errors errors;
+	volatile uint8_t* ready_pin;  // PINx register of the ready line, 0 for none
+	uint8_t ready_mask;
+} devices[TWI_LCD_MAX_DEVICES];
+
+// The commands of the transmission being built, sent by lcd_end()
+static uint8_t msg[BUFFER_LENGTH];
+static uint8_t msg_length;
+
+// What every revision can do, assumed for displays lcd_init() has not seen
+static const struct lcd_caps default_caps = {
+	.features = 0,
+	.rx_buffer = 15,
+	.max_batch = 15,
+	.cols = 16,
+	.rows = 2,
+	.max_speed = 1,
+	.max_frame = 0,
+	.revision = 0,
+};
+
+static struct lcd_device* lcd_device(uint8_t addr)
+{
+	for (uint8_t i = 0; i < TWI_LCD_MAX_DEVICES; i++)
+		if (devices[i].addr == addr)
+			return &devices[i];
+	return 0;
+}
+
+static const struct lcd_caps* lcd_caps(uint8_t addr)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	return dev ? &dev->caps : &default_caps;
+}
+
+static void lcd_count_error(uint8_t addr, uint8_t ret)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (!dev)
+		return;
+	if (ret == 2 || ret == 3)
+		dev->errors.nacks++;
+	else if (ret == 4)
+		dev->errors.bus_errors++;
+	else if (ret == 5)
+		dev->errors.timeouts++;
+	else if (ret == 6)
+		dev->errors.frames++;
+}
+
+static void lcd_count_retry(uint8_t addr)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev)
+		dev->errors.retries++;
+}
+
+// Send <data> to the display. It is sent again while the display does not
+// answer to its address, which means none of it arrived. Anything else
+// could have been partly processed and is only counted.
+static uint8_t lcd_transmit(uint8_t addr, uint8_t* data, uint8_t length)
+{
+	uint8_t ret;
+
+	twi_begin_transmission(addr);
+	twi_send(data, length);
+	ret = twi_end_transmission();
+
+	for (uint8_t i = 0; ret == 2 && i < TWI_LCD_RETRIES; i++) {
+		lcd_count_error(addr, ret);
+		lcd_count_retry(addr);
+		_delay_us(TWI_LCD_RETRY_DELAY_US);
+		ret = twi_retransmit();
+	}
+	lcd_count_error(addr, ret);
+	return ret;
+}
+
+// Read <quantity> bytes of a reply, a short read is counted as an error
+static uint8_t lcd_request(uint8_t addr, uint8_t quantity)
+{
+	uint8_t read = twi_request_from(addr, quantity);
+
+	if (read < quantity)
+		lcd_count_error(addr, twi_timed_out() ? 5 : 2);
+	return read;
+}
+
+static uint8_t lcd_crc8(uint8_t crc, uint8_t data)
+{
+	crc ^= data;
+	for (uint8_t i = 0; i < 8; i++)
+		crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+	return crc;
+}
+
+// Send the commands as a frame and read its status. lcd_transmit() resends
+// it while the display does not answer to its address, and it is sent again
+// here when the display reports it corrupted and dropped. A missing or
+// unknown status is an error: the frame may have run, so it is not resent.
+static uint8_t lcd_transmit_frame(uint8_t addr)
+{
+	uint8_t frame[BUFFER_LENGTH];
+	uint8_t crc, i, ret;
+
+	frame[0] = 0xf2;
+	frame[1] = msg_length;
+	crc = lcd_crc8(0, msg_length);
+	for (i = 0; i < msg_length; i++) {
+		frame[i + 2] = msg[i];
+		crc = lcd_crc8(crc, msg[i]);
+	}
+	frame[i + 2] = crc;
+
+	for (i = 0; ; i++) {
+		ret = lcd_transmit(addr, frame, msg_length + 3);
+		if (ret)
+			return ret;
+		ret = lcd_request(addr, 1) == 1 ? twi_receive() : 0;
+		if (ret == LCD_FRAME_ACK)
+			return 0;
+		lcd_count_error(addr, 6);
+		if (ret != LCD_FRAME_NAK || i == TWI_LCD_RETRIES)
+			return 6;
+		lcd_count_retry(addr);
+	}
+}
+
+static void lcd_begin(void)
+{
+	msg_length = 0;
+}
+
+static void lcd_send(uint8_t data)
+{
+	if (msg_length < sizeof(msg))
+		msg[msg_length++] = data;
+}
+
+// Send the commands collected since lcd_begin(), framed when the display
+// is in framed mode
+static uint8_t lcd_end(uint8_t addr)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev && dev->framed)
+		return lcd_transmit_frame(addr);
+	return lcd_transmit(addr, msg, msg_length);
+}
+
+// Run the bus as fast as the slowest display that has been set up allows
+static void lcd_set_bus_speed(void)
+{
+	uint8_t speed = TWI_LCD_MAX_FREQ / 100000L;
+
+	for (uint8_t i = 0; i < TWI_LCD_MAX_DEVICES; i++)
+		if (devices[i].addr && devices[i].caps.max_speed < speed)
+			speed = devices[i].caps.max_speed;
+	if (speed)
+		twi_set_clock(speed * 100000L);
+}
+
+void lcd_set_ready_pin(uint8_t addr, volatile uint8_t* pin, uint8_t mask)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev) {
+		dev->ready_pin = pin;
+		dev->ready_mask = mask;
+	}
+}
+
+// Give the display time to finish a slow command. With a ready line the
+// wait ends when the display pulls it low. Otherwise displays with flow
+// control hold the bus until they can take more, so there is nothing to
+// wait for, and older ones get the full time.
+bool lcd_wait_ready(uint8_t addr, uint8_t ms)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev && dev->ready_pin) {
+		for (uint16_t i = 0; i < ms * 100; i++) {
+			if (!(*dev->ready_pin & dev->ready_mask))
+				return true;
+			_delay_us(10);
+		}
+		return false;
+	}
+
+	if (lcd_caps(addr)->features & LCD_CAP_FLOW_CONTROL)
+		return true;
+	while (ms--)
+		_delay_ms(1);
+	return true;
+}
+
 void lcd_init(uint8_t addr, uint8_t cols, uint8_t lines)
 {
+	struct lcd_caps caps;
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (!dev)
+		dev = lcd_device(0);
+	if (dev) {
+		// remember the display first so that errors during setup are counted
+		dev->addr = addr;
+		dev->caps = default_caps;
+	}
+
 	lcd_reset(addr);
-	twi_begin_transmission(addr);
-	twi_send_byte(0xfd); // Setup the display
-	twi_send_byte(cols); // number of cols
-	twi_send_byte(lines); // number of lines
-	twi_end_transmission();
 	_delay_ms(5);
+
+	lcd_get_caps(addr, &caps);
+	if (caps.features & LCD_CAP_GEOMETRY) {
+		lcd_begin();
+		lcd_send(0xfd); // Setup the display
+		lcd_send(cols); // number of cols
+		lcd_send(lines); // number of lines
+		lcd_end(addr);
+	}
+	caps.cols = cols;
+	caps.rows = lines;
+	if (dev)
+		dev->caps = caps;
+
+	lcd_set_bus_speed();
+	lcd_wait_ready(addr, 5);
 }
 
 void lcd_reset(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xFF); // sending some NOP to clear input buffer on display
-	twi_send_byte(0xFF); // sending some NOP to clear input buffer on display
-	twi_send_byte(0xFF); // sending some NOP to clear input buffer on display
-	twi_send_byte(0xFF); // sending some NOP to clear input buffer on display
-	twi_send_byte(0xFE); // clear
-	twi_end_transmission();	
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev)
+		dev->framed = false;
+
+	lcd_begin();
+	lcd_send(0xFF); // sending some NOP to clear input buffer on display
+	lcd_send(0xFF); // sending some NOP to clear input buffer on display
+	lcd_send(0xFF); // sending some NOP to clear input buffer on display
+	lcd_send(0xFF); // sending some NOP to clear input buffer on display
+	lcd_send(0xF1); // leave framed mode, older revisions print the 0
+	lcd_send(0x00);
+	lcd_send(0xFE); // clear
+	lcd_end(addr);	
 }
 
 void lcd_change_address(uint8_t cur_addr, uint8_t new_addr)
 {
-	twi_begin_transmission(cur_addr);
-	twi_send_byte(0x81); // change address
-	twi_send_byte(new_addr);
-	twi_end_transmission();
-	_delay_ms(5);
+	lcd_begin();
+	lcd_send(0x81); // change address
+	lcd_send(new_addr);
+	lcd_end(cur_addr);
+	lcd_wait_ready(cur_addr, 5);
+
+	struct lcd_device* dev = lcd_device(cur_addr);
+	if (dev)
+		dev->addr = new_addr;
 }
 
 void lcd_set_brightness(uint8_t addr, uint8_t brightness)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xd3); // set brightness
-	twi_send_byte(brightness);
-	twi_end_transmission();
+	lcd_begin();
+	lcd_send(0xd3); // set brightness
+	lcd_send(brightness);
+	lcd_end(addr);
 }
 
 void lcd_save_brightness(uint8_t addr, uint8_t brightness)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x80); // save brightness
-	twi_send_byte(brightness);
-	twi_end_transmission();
-	_delay_ms(5);
+	lcd_begin();
+	lcd_send(0x80); // save brightness
+	lcd_send(brightness);
+	lcd_end(addr);
+	lcd_wait_ready(addr, 5);
 }
 
 void lcd_set_contrast(uint8_t addr, uint8_t contrast)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xd1); // set contrast
-	twi_send_byte(contrast);
-	twi_end_transmission();
+	lcd_begin();
+	lcd_send(0xd1); // set contrast
+	lcd_send(contrast);
+	lcd_end(addr);
 }
 
 void lcd_save_contrast(uint8_t addr, uint8_t contrast)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xd0); // save contrast
-	twi_send_byte(contrast);
-	twi_end_transmission();
-	_delay_ms(5);
+	lcd_begin();
+	lcd_send(0xd0); // save contrast
+	lcd_send(contrast);
+	lcd_end(addr);
+	lcd_wait_ready(addr, 5);
 }
 
 void lcd_clear(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x82); // clear
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x82); // clear
+	lcd_end(addr);	
 }
 
 void lcd_home(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x91); // home
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x91); // home
+	lcd_end(addr);	
 }
 
 void lcd_create_char(uint8_t addr, uint8_t location, uint8_t* charmap)
 {
-	_delay_ms(5);
-	twi_begin_transmission(addr);
-	twi_send_byte(0x9f); // create custom character
-	twi_send_byte(location&0x7); // we only have 8 locations 0-7
+	lcd_wait_ready(addr, 5);
+	lcd_begin();
+	lcd_send(0x9f); // create custom character
+	lcd_send(location&0x7); // we only have 8 locations 0-7
 	
 	for (int i=0; i<8; i++)
-		twi_send_byte(charmap[i]);
+		lcd_send(charmap[i]);
 	
-	twi_end_transmission();	
-	_delay_ms(25);
+	lcd_end(addr);	
+	lcd_wait_ready(addr, 25);
 }
 
 
 void lcd_display_on(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x94);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x94);
+	lcd_end(addr);	
 }
 
 void lcd_display_off(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x93);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x93);
+	lcd_end(addr);	
 }
 
 void lcd_cursor_on(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x96);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x96);
+	lcd_end(addr);	
 }
 
 void lcd_cursor_off(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x95);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x95);
+	lcd_end(addr);	
 }
 
 void lcd_blink_on(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x98);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x98);
+	lcd_end(addr);	
 }
 
 void lcd_blink_off(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x97);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x97);
+	lcd_end(addr);	
 }
 
 void lcd_scroll_on(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x9d);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x9d);
+	lcd_end(addr);	
 }
 
 void lcd_scroll_off(uint8_t addr)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0x9e);
-	twi_end_transmission();	
+	lcd_begin();
+	lcd_send(0x9e);
+	lcd_end(addr);	
 }
 
 
 void lcd_set_position(uint8_t addr, uint8_t col, uint8_t row)
 {	
-	twi_begin_transmission(addr);
-	twi_send_byte(0x92); // set position
-	twi_send_byte(col);
-	twi_send_byte(row);
-	twi_end_transmission();
+	lcd_begin();
+	lcd_send(0x92); // set position
+	lcd_send(col);
+	lcd_send(row);
+	lcd_end(addr);
 }
 
 void lcd_write_char(uint8_t addr, char val)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xa4);
-	twi_send_byte(val);
-	twi_end_transmission();
+	lcd_begin();
+	lcd_send(0xa4);
+	lcd_send(val);
+	lcd_end(addr);
 }
 
+// Send the string in as few transactions as the display allows. Characters
+// that would be taken as commands on their own are sent with 0xa4.
 void lcd_write_str(uint8_t addr, char* val)
 {	
-	for (uint8_t i = 0; i < strlen(val); i++) {
-		lcd_write_char(addr, val[i]);
+	struct lcd_device* dev = lcd_device(addr);
+	const struct lcd_caps* caps = lcd_caps(addr);
+	uint8_t batch = BUFFER_LENGTH;
+
+	if (caps->max_batch && caps->max_batch < batch)
+		batch = caps->max_batch;
+	if (dev && dev->framed) {
+		if (batch > BUFFER_LENGTH - 3)
+			batch = BUFFER_LENGTH - 3;
+		if (batch > caps->max_frame)
+			batch = caps->max_frame;
+	}
+	// room for at least one character sent with 0xa4
+	if (batch < 2)
+		batch = 2;
+
+	while (*val) {
+		uint8_t n = 0;
+
+		lcd_begin();
+		while (*val && n < batch - 1) {
+			uint8_t c = *val++;
+			if (c <= 9 || c >= 0x80) {
+				lcd_send(0xa4);
+				n++;
+			}
+			lcd_send(c);
+			n++;
+		}
+		lcd_end(addr);
 	}
 }
 
 int lcd_get_firmware_revision(uint8_t addr)
 {
-  twi_begin_transmission(addr);
-  twi_send_byte(0x8a); // get firmware revision
-  twi_end_transmission();
+  lcd_begin();
+  lcd_send(0x8a); // get firmware revision
+  lcd_end(addr);
 
-  twi_request_from(addr, 1);
+  lcd_request(addr, 1);
   return twi_receive();
 }
 
+bool lcd_get_position(uint8_t addr, uint8_t* col, uint8_t* row)
+{
+	// older revisions would print the bytes that follow the unknown command
+	if (lcd_caps(addr)->revision < 6)
+		return false;
+
+	lcd_begin();
+	lcd_send(0x86); // get cursor position
+	lcd_end(addr);
+
+	if (lcd_request(addr, 2) < 2)
+		return false;
+	*col = twi_receive();
+	*row = twi_receive();
+	return true;
+}
+
+// A reply holds at most LCD_READ_MAX characters and stops at the end of
+// the row, longer reads take several
+uint8_t lcd_read_screen(uint8_t addr, uint8_t col, uint8_t row, uint8_t* buffer, uint8_t size)
+{
+	uint8_t n = 0;
+
+	if (lcd_caps(addr)->revision < 6)
+		return 0;
+
+	while (n < size) {
+		uint8_t chunk = size - n < LCD_READ_MAX ? size - n : LCD_READ_MAX;
+		uint8_t length;
+
+		lcd_begin();
+		lcd_send(0x8f); // read screen
+		lcd_send(row);
+		lcd_send(col + n);
+		lcd_send(chunk);
+		lcd_end(addr);
+
+		if (lcd_request(addr, chunk + 1) < 1 || (length = twi_receive()) > chunk)
+			break;
+		for (uint8_t i = 0; i < length; i++)
+			buffer[n++] = twi_receive();
+		if (length < chunk)
+			break; // end of the row
+	}
+	return n;
+}
+
+void lcd_get_caps(uint8_t addr, struct lcd_caps* caps)
+{
+	int rev = lcd_get_firmware_revision(addr);
+	uint8_t length;
+
+	*caps = default_caps;
+	caps->revision = rev;
+
+	// Revisions before 6 do not know the capability command
+	if (rev < 6) {
+		if (rev >= 2)
+			caps->features |= LCD_CAP_GEOMETRY;
+		if (rev >= 3)
+			caps->features |= LCD_CAP_BRIGHTNESS;
+		if (rev >= 4)
+			caps->features |= LCD_CAP_COLOR;
+		return;
+	}
+
+	lcd_begin();
+	lcd_send(0x8e); // get capabilities
+	lcd_end(addr);
+
+	if (lcd_request(addr, LCD_CAPS_LENGTH) < 8 || (length = twi_receive()) < 8)
+		return;
+	caps->features = twi_receive();
+	caps->features |= twi_receive() << 8;
+	caps->rx_buffer = twi_receive();
+	caps->max_batch = twi_receive();
+	caps->cols = twi_receive();
+	caps->rows = twi_receive();
+	caps->max_speed = twi_receive();
+	if (length >= 9)
+		caps->max_frame = twi_receive();
+}
+
+bool lcd_set_framed(uint8_t addr, bool on)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (!dev || !(dev->caps.features & LCD_CAP_FRAMING))
+		return false;
+
+	// 0xf1 is taken outside of frames in either mode
+	uint8_t cmd[2] = { 0xf1, on };
+	if (lcd_transmit(addr, cmd, sizeof(cmd)))
+		return false;
+	dev->framed = on;
+	return true;
+}
+
+void lcd_get_errors(uint8_t addr, struct lcd_errors* errors)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev)
+		*errors = dev->errors;
+	else
+		memset(errors, 0, sizeof(*errors));
+}
+
+void lcd_clear_errors(uint8_t addr)
+{
+	struct lcd_device* dev = lcd_device(addr);
+
+	if (dev)
+		memset(&dev->errors, 0, sizeof(dev->errors));
+}
+
 // Low level commands
 
 void lcd_raw_command(uint8_t addr, uint8_t command)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xa3);
-	twi_send_byte(command);
-	twi_end_transmission();
+	lcd_begin();
+	lcd_send(0xa3);
+	lcd_send(command);
+	lcd_end(addr);
 }
 
 void lcd_raw_data(uint8_t addr, uint8_t data)
 {
-	twi_begin_transmission(addr);
-	twi_send_byte(0xa5);
-	twi_send_byte(data);
-	twi_end_transmission();
+	lcd_begin();
+	lcd_send(0xa5);
+	lcd_send(data);
+	lcd_end(addr);
 }
 
@@ -19,6 +19,66 @@
 #include <stdbool.h>
 #include "twi.h"
 
+// Highest SCL frequency lcd_init() may switch the bus to. Displays with
+// firmware revision 6 or later handle Fast-mode (400kHz); set this to
+// 100000L when other devices on the bus only support Standard-mode.
+#ifndef TWI_LCD_MAX_FREQ
+#define TWI_LCD_MAX_FREQ 400000L
+#endif
+
+// Number of displays whose capabilities lcd_init() remembers
+#ifndef TWI_LCD_MAX_DEVICES
+#define TWI_LCD_MAX_DEVICES 2
+#endif
+
+// How often a transmission is sent again when the display does not answer
+// to its address, and how long to wait before each retry
+#ifndef TWI_LCD_RETRIES
+#define TWI_LCD_RETRIES 2
+#endif
+#ifndef TWI_LCD_RETRY_DELAY_US
+#define TWI_LCD_RETRY_DELAY_US 100
+#endif
+
+// Feature flags of struct lcd_caps
+#define LCD_CAP_GEOMETRY      0x0001  // set columns/rows
+#define LCD_CAP_BRIGHTNESS    0x0002  // set brightness without saving it
+#define LCD_CAP_COLOR         0x0004  // RGB backlight commands
+#define LCD_CAP_SAFEMODE      0x0008  // brightness is limited in safemode
+#define LCD_CAP_FLOW_CONTROL  0x0010  // the display holds the bus instead of dropping bytes
+#define LCD_CAP_PROFILING     0x0020  // performance counters
+#define LCD_CAP_FRAMING       0x0040  // framed commands with CRC, see lcd_set_framed()
+
+// Bytes of the capability record this library reads
+#define LCD_CAPS_LENGTH 9
+
+// Status the display answers a frame with in framed mode
+#define LCD_FRAME_ACK 0x06
+#define LCD_FRAME_NAK 0x15
+
+// Characters the display sends back for one lcd_read_screen() request
+#define LCD_READ_MAX 14
+
+struct lcd_caps {
+	uint16_t features;    // LCD_CAP_ flags
+	uint8_t rx_buffer;    // number of bytes the receive buffer of the display holds
+	uint8_t max_batch;    // longest write that is safe to send, 0 for no limit
+	uint8_t cols;
+	uint8_t rows;
+	uint8_t max_speed;    // highest SCL frequency, in units of 100kHz
+	uint8_t max_frame;    // longest frame, 0 without framing
+	uint8_t revision;     // firmware revision
+};
+
+// Bus errors counted for each display set up with lcd_init()
+struct lcd_errors {
+	uint16_t nacks;       // address or data not acknowledged
+	uint16_t timeouts;    // transfers abandoned after TWI_TIMEOUT_US, the bus was cleared
+	uint16_t bus_errors;  // lost arbitration, illegal start or stop
+	uint16_t retries;     // transmissions sent again
+	uint16_t frames;      // frames the display did not acknowledge
+};
+
 void lcd_init(uint8_t addr, uint8_t cols, uint8_t lines);
 void lcd_reset(uint8_t addr);
 
@@ -47,6 +107,30 @@ void lcd_write_char(uint8_t addr, char val);
 void lcd_write_str(uint8_t addr, char* val);
 
 int lcd_get_firmware_revision(uint8_t addr);
+bool lcd_get_position(uint8_t addr, uint8_t* col, uint8_t* row);
+// Read <size> characters of a row back from the display, so the screen does
+// not have to be mirrored. Returns the number read, fewer at the end of the row.
+uint8_t lcd_read_screen(uint8_t addr, uint8_t col, uint8_t row, uint8_t* buffer, uint8_t size);
+void lcd_get_caps(uint8_t addr, struct lcd_caps* caps);
+void lcd_get_errors(uint8_t addr, struct lcd_errors* errors);
+void lcd_clear_errors(uint8_t addr);
+
+// In framed mode every transmission is sent with a length and CRC and
+// checked by the display. A frame it did not get intact is not executed
+// and is sent again, and the display resynchronizes at the next frame
+// after a byte got lost. A frame whose status does not come back may have
+// run and is only reported. Needs a display set up with lcd_init() that
+// reports LCD_CAP_FRAMING.
+bool lcd_set_framed(uint8_t addr, bool on);
+
+// Displays built with FEATURE_READY pull a ready line low once they have
+// executed what they were sent. Give the PINx register and bit mask of the
+// input it is connected to (with a pull-up), after lcd_init(). Waiting then
+// ends as soon as the display is done, lcd_wait_ready() returns false when
+// <ms> pass first. Without a ready line it waits the full time, unless the
+// display holds the bus by itself.
+void lcd_set_ready_pin(uint8_t addr, volatile uint8_t* pin, uint8_t mask);
+bool lcd_wait_ready(uint8_t addr, uint8_t ms);
 
 // Low level commands
 void lcd_raw_command(uint8_t addr, uint8_t command);
@@ -23,6 +23,7 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <compat/twi.h>
+#include <util/delay.h>
 
 #ifndef cbi
 #define cbi(sfr, bit) (_SFR_BYTE(sfr) &= ~_BV(bit))
@@ -34,6 +35,23 @@
 
 #include "twi-lowlevel.h"
 
+#if defined(__AVR_ATmega168__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega328P__)
+  #define TWI_PORT PORTC
+  #define TWI_DDR  DDRC
+  #define TWI_PIN  PINC
+  #define TWI_SDA  4
+  #define TWI_SCL  5
+#else
+  #define TWI_PORT PORTD
+  #define TWI_DDR  DDRD
+  #define TWI_PIN  PIND
+  #define TWI_SDA  1
+  #define TWI_SCL  0
+#endif
+
+// the busy waits below poll in steps of TWI_POLL_US
+#define TWI_POLL_US 10
+
 static volatile uint8_t twi_state;
 static uint8_t twi_slarw;
 
@@ -53,6 +71,9 @@ static volatile uint8_t twi_rxBufferIndex;
 
 static volatile uint8_t twi_error;
 
+static uint16_t twi_timeout = TWI_TIMEOUT_US / TWI_POLL_US;
+static uint8_t twi_timeout_flag;
+
 /* 
  * Function twi_init
  * Desc     readys twi pins and sets twi bitrate
@@ -64,30 +85,133 @@ void twi_init(void)
   // initialize state
   twi_state = TWI_READY;
 
-  #if defined(__AVR_ATmega168__) || defined(__AVR_ATmega8__) || defined(__AVR_ATmega328P__)
-    // activate internal pull-ups for twi
-    // as per note from atmega8 manual pg167
-    sbi(PORTC, 4);
-    sbi(PORTC, 5);
-  #else
-    // activate internal pull-ups for twi
-    // as per note from atmega128 manual pg204
-    sbi(PORTD, 0);
-    sbi(PORTD, 1);
-  #endif
+  // activate internal pull-ups for twi
+  // as per note from atmega8 manual pg167 and atmega128 manual pg204
+  sbi(TWI_PORT, TWI_SDA);
+  sbi(TWI_PORT, TWI_SCL);
 
   // initialize twi prescaler and bit rate
+  twi_setFrequency(TWI_FREQ);
+
+  // enable twi module, acks, and twi interrupt
+  TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+}
+
+/* 
+ * Function twi_setFrequency
+ * Desc     sets the SCL frequency of master transfers
+ * Input    frequency: SCL frequency in Hz
+ * Output   none
+ */
+void twi_setFrequency(uint32_t frequency)
+{
   cbi(TWSR, TWPS0);
   cbi(TWSR, TWPS1);
-  TWBR = ((CPU_FREQ / TWI_FREQ) - 16) / 2;
+  TWBR = ((CPU_FREQ / frequency) - 16) / 2;
 
   /* twi bit rate formula from atmega128 manual pg 204
   SCL Frequency = CPU Clock Frequency / (16 + (2 * TWBR))
   note: TWBR should be 10 or higher for master mode
-  It is 72 for a 16mhz Wiring board with 100kHz TWI */
+  It is 72 for a 16mhz Wiring board with 100kHz TWI
+  and 12 with 400kHz TWI */
+}
 
-  // enable twi module, acks, and twi interrupt
+/* 
+ * Function twi_setTimeout
+ * Desc     sets how long a master transfer may take before it is
+ *          abandoned, 0 waits forever
+ * Input    us: timeout in microseconds
+ * Output   none
+ */
+void twi_setTimeout(uint32_t us)
+{
+  twi_timeout = (us + TWI_POLL_US - 1) / TWI_POLL_US;
+}
+
+/* 
+ * Function twi_timedOut
+ * Desc     tells whether the last master transfer timed out
+ * Input    none
+ * Output   1 .. it timed out and the bus was cleared
+ *          0 .. no timeout
+ */
+uint8_t twi_timedOut(void)
+{
+  return twi_timeout_flag;
+}
+
+/* 
+ * Function twi_wait
+ * Desc     waits while twi_state is <state>, for at most the timeout
+ * Input    state: state to wait for to end
+ * Output   1 .. the state ended
+ *          0 .. timed out, the bus was cleared
+ */
+static uint8_t twi_wait(uint8_t state)
+{
+  uint16_t left = twi_timeout;
+
+  while(state == twi_state){
+    if(twi_timeout){
+      if(left-- == 0){
+        twi_timeout_flag = 1;
+        twi_clearBus();
+        return 0;
+      }
+      _delay_us(TWI_POLL_US);
+    }
+  }
+  return 1;
+}
+
+/* 
+ * Function twi_clearBus
+ * Desc     takes the pins from the twi module and clocks SCL until a slave
+ *          stuck in the middle of a byte releases SDA, then sends a stop
+ *          condition and restarts the twi module (I2C-bus specification,
+ *          section 3.1.16)
+ * Input    none
+ * Output   1 .. both lines are high again
+ *          0 .. a slave still holds SDA or SCL low
+ */
+uint8_t twi_clearBus(void)
+{
+  uint8_t i;
+
+  // switch the twi module off, the pins are released with the pull-ups on
+  TWCR = 0;
+  cbi(TWI_DDR, TWI_SDA);
+  cbi(TWI_DDR, TWI_SCL);
+  _delay_us(5);
+
+  // up to nine clocks so that the slave finishes the byte it is sending
+  for(i = 0; i < 9 && !(TWI_PIN & _BV(TWI_SDA)); i++){
+    cbi(TWI_PORT, TWI_SCL);
+    sbi(TWI_DDR, TWI_SCL);
+    _delay_us(5);
+    cbi(TWI_DDR, TWI_SCL);
+    sbi(TWI_PORT, TWI_SCL);
+    _delay_us(5);
+  }
+
+  // stop condition: SDA rises while SCL is high
+  cbi(TWI_PORT, TWI_SCL);
+  sbi(TWI_DDR, TWI_SCL);
+  cbi(TWI_PORT, TWI_SDA);
+  sbi(TWI_DDR, TWI_SDA);
+  _delay_us(5);
+  cbi(TWI_DDR, TWI_SCL);
+  sbi(TWI_PORT, TWI_SCL);
+  _delay_us(5);
+  cbi(TWI_DDR, TWI_SDA);
+  sbi(TWI_PORT, TWI_SDA);
+  _delay_us(5);
+
+  // restart the twi module
+  twi_state = TWI_READY;
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA);
+
+  return (TWI_PIN & (_BV(TWI_SDA) | _BV(TWI_SCL))) == (_BV(TWI_SDA) | _BV(TWI_SCL));
 }
 
 /* 
@@ -120,9 +244,13 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length)
     return 0;
   }
 
+  twi_timeout_flag = 0;
+
   // wait until twi is ready, become master receiver
   while(TWI_READY != twi_state){
-    continue;
+    if(!twi_wait(twi_state)){
+      return 0;
+    }
   }
   twi_state = TWI_MRX;
   // reset error state (0xFF.. no error occured)
@@ -145,8 +273,8 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length)
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTA);
 
   // wait for read operation to complete
-  while(TWI_MRX == twi_state){
-    continue;
+  if(!twi_wait(TWI_MRX)){
+    return 0;
   }
 
   if (twi_masterBufferIndex < length)
@@ -173,6 +301,7 @@ uint8_t twi_readFrom(uint8_t address, uint8_t* data, uint8_t length)
  *          2 .. address send, NACK received
  *          3 .. data send, NACK received
  *          4 .. other twi error (lost bus arbitration, bus error, ..)
+ *          5 .. timeout, the bus was cleared
  */
 uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait)
 {
@@ -183,9 +312,13 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
     return 1;
   }
 
+  twi_timeout_flag = 0;
+
   // wait until twi is ready, become master transmitter
   while(TWI_READY != twi_state){
-    continue;
+    if(!twi_wait(twi_state)){
+      return 5;
+    }
   }
   twi_state = TWI_MTX;
   // reset error state (0xFF.. no error occured)
@@ -208,8 +341,8 @@ uint8_t twi_writeTo(uint8_t address, uint8_t* data, uint8_t length, uint8_t wait
   TWCR = _BV(TWEN) | _BV(TWIE) | _BV(TWEA) | _BV(TWINT) | _BV(TWSTA);
 
   // wait for write operation to complete
-  while(wait && (TWI_MTX == twi_state)){
-    continue;
+  if(wait && !twi_wait(TWI_MTX)){
+    return 5;
   }
   
   if (twi_error == 0xFF)
@@ -306,8 +439,11 @@ void twi_stop(void)
 
   // wait for stop condition to be exectued on bus
   // TWINT is not set after a stop condition!
-  while(TWCR & _BV(TWSTO)){
-    continue;
+  // a slave holding SCL low would keep us here, so give up after the
+  // timeout and let the next transfer clear the bus
+  uint32_t left = (uint32_t)twi_timeout * TWI_POLL_US;
+  while((TWCR & _BV(TWSTO)) && (!twi_timeout || left--)){
+    _delay_us(1);
   }
 
   // update twi state
@@ -36,6 +36,12 @@
 #define TWI_BUFFER_LENGTH 32
 #endif
 
+// Longest a master transfer, including the time a slave holds SCL low, may
+// take before it is abandoned and the bus is cleared
+#ifndef TWI_TIMEOUT_US
+#define TWI_TIMEOUT_US 25000L
+#endif
+
 #define TWI_READY 0
 #define TWI_MRX   1
 #define TWI_MTX   2
@@ -44,6 +50,10 @@
 
 void twi_init(void);
 void twi_setAddress(uint8_t);
+void twi_setFrequency(uint32_t);
+void twi_setTimeout(uint32_t);
+uint8_t twi_timedOut(void);
+uint8_t twi_clearBus(void);
 uint8_t twi_readFrom(uint8_t, uint8_t*, uint8_t);
 uint8_t twi_writeTo(uint8_t, uint8_t*, uint8_t, uint8_t);
 uint8_t twi_transmit(uint8_t*, uint8_t);
@@ -33,6 +33,7 @@ uint8_t txAddress = 0;
 uint8_t txBuffer[BUFFER_LENGTH];
 uint8_t txBufferIndex = 0;
 uint8_t txBufferLength = 0;
+uint8_t txLastLength = 0;
 
 uint8_t transmitting = 0;
 void (*user_onRequest)(void);
@@ -60,6 +61,21 @@ void twi_init_slave(uint8_t address)
   twi_init_master();
 }
 
+void twi_set_clock(uint32_t frequency)
+{
+  twi_setFrequency(frequency);
+}
+
+void twi_set_timeout(uint32_t us)
+{
+  twi_setTimeout(us);
+}
+
+uint8_t twi_timed_out(void)
+{
+  return twi_timedOut();
+}
+
 uint8_t twi_request_from(uint8_t address, uint8_t quantity)
 {
   // clamp to buffer length
@@ -90,6 +106,8 @@ uint8_t twi_end_transmission(void)
 {
   // transmit buffer (blocking)
   int8_t ret = twi_writeTo(txAddress, txBuffer, txBufferLength, 1);
+  // keep the length for twi_retransmit()
+  txLastLength = txBufferLength;
   // reset tx buffer iterator vars
   txBufferIndex = 0;
   txBufferLength = 0;
@@ -98,6 +116,13 @@ uint8_t twi_end_transmission(void)
   return ret;
 }
 
+// sends the last transmission again after twi_end_transmission() failed,
+// must be called before the next twi_begin_transmission()
+uint8_t twi_retransmit(void)
+{
+  return twi_writeTo(txAddress, txBuffer, txLastLength, 1);
+}
+
 // must be called in:
 // slave tx event callback
 // or after beginTransmission(address)
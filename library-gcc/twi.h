@@ -26,8 +26,12 @@
 
 void twi_init_master(void);
 void twi_init_slave(uint8_t);
+void twi_set_clock(uint32_t);
+void twi_set_timeout(uint32_t);
+uint8_t twi_timed_out(void);
 void twi_begin_transmission(uint8_t);
 uint8_t twi_end_transmission(void);
+uint8_t twi_retransmit(void);
 uint8_t twi_request_from(uint8_t, uint8_t);
 void twi_send_byte(uint8_t);
 void twi_send(uint8_t*, uint8_t);
@@ -0,0 +1,67 @@
+#!/bin/sh
+#
+# Run the bench workloads through the simulator and compare the results
+# with a baseline.
+#
+# usage: bench.sh simulator baseline tolerance workload.twi...
+#
+# Every line of the results is "workload metric value", lower is better for
+# all metrics. A value more than <tolerance> percent above the baseline is a
+# regression and makes the script fail. With a baseline of "-" the results
+# are only printed, which is how the baseline is made.
+#
+
+sim=$1
+baseline=$2
+tolerance=$3
+shift 3
+
+results=${TMPDIR:-/tmp}/bench.$$
+trap 'rm -f "$results"' EXIT
+
+for script in "$@"; do
+	name=`basename "$script" .twi`
+	"$sim" -m "$script" > "$results.1" || { rm -f "$results.1"; echo "$name: simulation failed" >&2; exit 1; }
+	sed "s/^/$name /" "$results.1" >> "$results"
+	rm -f "$results.1"
+done
+
+if [ "$baseline" = "-" ]; then
+	cat "$results"
+	exit 0
+fi
+
+if [ ! -f "$baseline" ]; then
+	echo "no baseline $baseline, run make bench-baseline first" >&2
+	exit 1
+fi
+
+awk -v tolerance="$tolerance" '
+	BEGIN { printf "%-12s %-24s %12s %12s\n", "workload", "metric", "baseline", "now" }
+	FNR == NR { base[$1 " " $2] = $3; next }
+	{
+		key = $1 " " $2
+		if (!(key in base)) {
+			printf "%-12s %-24s %12s %12d  new\n", $1, $2, "-", $3
+			next
+		}
+		seen[key] = 1
+		status = ""
+		if ($3 > base[key] * (1 + tolerance / 100)) {
+			status = "  REGRESSION"
+			failed++
+		} else if ($3 < base[key])
+			status = "  better"
+		printf "%-12s %-24s %12d %12d%s\n", $1, $2, base[key], $3, status
+	}
+	END {
+		for (key in base)
+			if (!(key in seen)) {
+				printf "%-26s no longer reported\n", key
+			}
+		if (failed) {
+			printf "%d regressions against the baseline\n", failed
+			exit 1
+		}
+	}
+' "$baseline" "$results"
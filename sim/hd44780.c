@@ -0,0 +1,417 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Behavioral model of a HD44780 or KS0073 display controller on the
+ * firmware's LCD port: DDRAM, CGRAM, address counter, display shift, 4 and
+ * 8 bit interface and busy time. The pin assignment comes from the
+ * firmware's own lcd.h. The 4x40 board has a second controller on E2.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <avr/io.h>
+#include "lcd.h"
+
+#ifndef LCD_DATA_BITS
+#define LCD_DATA_BITS 4
+#endif
+
+#ifdef LCD_E2_PIN
+#define SIM_CONTROLLERS 2
+#else
+#define SIM_CONTROLLERS 1
+#endif
+
+#define DDR(x) (*(&x - 1))
+#define PIN(x) (*(&x - 2))
+
+/* execution times at the typical 270kHz oscillator */
+#define SIM_US_CLEAR    1520
+#define SIM_US_COMMAND  37
+#define SIM_US_DATA     41           /* incl. the address counter update */
+
+#define US(us)  ((uint64_t)(us) * (F_CPU / 1000000))
+
+struct hd44780 {
+    uint8_t  ddram[128];
+    uint8_t  cgram[64];
+    uint8_t  ac;
+    uint8_t  dr;                     /* data register, what a data read returns */
+    uint8_t  dr_stale;               /* written since it was last loaded from the RAM */
+    uint8_t  cg;                     /* address counter points into CGRAM */
+    uint8_t  inc;                    /* entry mode: increment */
+    uint8_t  shift;                  /* entry mode: shift display */
+    uint8_t  display, cursor, blink;
+    uint8_t  dl;                     /* 8 bit interface */
+    uint8_t  lines2;                 /* two line mode */
+    uint8_t  re;                     /* KS0073 extended register set */
+    uint8_t  nw;                     /* KS0073 four line mode */
+    uint8_t  offset;                 /* display shift */
+    uint8_t  nibble;                 /* 4 bit interface: low nibble expected */
+    uint8_t  latch;                  /* 4 bit interface: high nibble */
+    uint8_t  read_nibble;            /* 4 bit interface: low nibble of a read next */
+    uint64_t busy_until;
+    uint64_t poll_start;             /* first status read that returned busy, 0: none */
+};
+
+struct sim_lcd_stats sim_lcd;
+uint8_t sim_lcd_ks0073;
+
+static struct hd44780 ctl[SIM_CONTROLLERS];
+static uint8_t initialized;
+
+extern uint8_t lcd_lines;
+extern uint8_t lcd_disp_length;
+
+
+static void lcd_reset(struct hd44780 *c)
+{
+    memset(c, 0, sizeof(*c));
+    memset(c->ddram, ' ', sizeof(c->ddram));
+    c->dl = 1;
+    c->inc = 1;
+}
+
+
+static void lcd_step_ac(struct hd44780 *c, int8_t dir)
+{
+    if (c->cg) {
+        c->ac = (c->ac + dir) & 0x3F;
+        return;
+    }
+
+    c->ac += dir;
+    if (sim_lcd_ks0073 && c->nw)
+        c->ac &= 0x7F;
+    else if (c->lines2) {
+        /* two lines of 40: 0x00-0x27 and 0x40-0x67 */
+        if (c->ac == 0x28) c->ac = 0x40;
+        else if (c->ac == 0x68) c->ac = 0x00;
+        else if (c->ac == 0x3F) c->ac = 0x27;
+        else if (c->ac == 0xFF) c->ac = 0x67;
+    } else {
+        if (c->ac == 0x50) c->ac = 0x00;
+        else if (c->ac == 0xFF) c->ac = 0x4F;
+    }
+}
+
+
+/* the data register is loaded from the RAM on an address set, a cursor
+   shift and a data read. A data write leaves the written byte in it, so a
+   read that follows one without an address set returns that. */
+static void lcd_load_dr(struct hd44780 *c)
+{
+    c->dr = c->cg ? c->cgram[c->ac & 0x3F] : c->ddram[c->ac & 0x7F];
+    c->dr_stale = 0;
+}
+
+
+static void lcd_shift_display(struct hd44780 *c, int8_t dir)
+{
+    uint8_t width = c->lines2 ? 40 : 80;
+
+    c->offset = (c->offset + width + dir) % width;
+}
+
+
+static void lcd_instruction(struct hd44780 *c, uint8_t b)
+{
+    uint32_t us = SIM_US_COMMAND;
+
+    sim_lcd.instructions++;
+
+    if (b & 0x80) {
+        c->ac = b & 0x7F;
+        c->cg = 0;
+        lcd_load_dr(c);
+    } else if (b & 0x40) {
+        c->ac = b & 0x3F;
+        c->cg = 1;
+        lcd_load_dr(c);
+    } else if (b & 0x20) {
+        c->dl = (b & 0x10) != 0;
+        c->lines2 = (b & 0x08) != 0;
+        if (sim_lcd_ks0073)
+            c->re = (b & 0x04) != 0;
+    } else if (b & 0x10) {
+        if (!c->re) {
+            int8_t dir = (b & 0x04) ? 1 : -1;
+            if (b & 0x08)
+                lcd_shift_display(c, -dir);
+            else {
+                lcd_step_ac(c, dir);
+                lcd_load_dr(c);
+            }
+        }
+    } else if (b & 0x08) {
+        if (c->re)
+            c->nw = b & 0x01;        /* extended function set */
+        else {
+            c->display = (b & 0x04) != 0;
+            c->cursor = (b & 0x02) != 0;
+            c->blink = (b & 0x01) != 0;
+        }
+    } else if (b & 0x04) {
+        if (!c->re) {
+            c->inc = (b & 0x02) != 0;
+            c->shift = (b & 0x01) != 0;
+        }
+    } else if (b & 0x02) {
+        c->ac = 0;
+        c->cg = 0;
+        c->offset = 0;
+        us = SIM_US_CLEAR;
+    } else if (b & 0x01) {
+        memset(c->ddram, ' ', sizeof(c->ddram));
+        c->ac = 0;
+        c->cg = 0;
+        c->inc = 1;
+        c->offset = 0;
+        us = SIM_US_CLEAR;
+    }
+
+    c->busy_until = sim_now + US(us);
+}
+
+
+static void lcd_write_data(struct hd44780 *c, uint8_t b)
+{
+    sim_lcd.data++;
+
+    if (c->cg)
+        c->cgram[c->ac & 0x3F] = b;
+    else
+        c->ddram[c->ac & 0x7F] = b;
+    c->dr = b;
+    c->dr_stale = 1;
+    lcd_step_ac(c, c->inc ? 1 : -1);
+    if (c->shift && !c->cg)
+        lcd_shift_display(c, c->inc ? 1 : -1);
+
+    c->busy_until = sim_now + US(SIM_US_DATA);
+}
+
+
+static uint8_t lcd_read_byte(struct hd44780 *c, uint8_t rs)
+{
+    uint8_t b;
+
+    if (!rs) {
+        if (sim_now < c->busy_until) {
+            sim_lcd.busy_polls++;
+            if (!c->poll_start)
+                c->poll_start = sim_now;
+            return 0x80 | c->ac;
+        }
+        if (c->poll_start) {
+            sim_lcd.wait_cycles += sim_now - c->poll_start;
+            c->poll_start = 0;
+        }
+        return c->ac;
+    }
+
+    if (c->dr_stale)
+        sim_lcd.stale_reads++;
+    b = c->dr;
+    lcd_step_ac(c, c->inc ? 1 : -1);
+    lcd_load_dr(c);
+    c->busy_until = sim_now + US(SIM_US_DATA);
+    return b;
+}
+
+
+/* data lines as driven by the firmware, D7..D0 (4 bit: D7..D4 in the low nibble) */
+static uint8_t bus_sample(void)
+{
+    uint8_t b = 0;
+
+    if (LCD_DATA0_PORT & _BV(LCD_DATA0_PIN)) b |= 0x01;
+    if (LCD_DATA1_PORT & _BV(LCD_DATA1_PIN)) b |= 0x02;
+    if (LCD_DATA2_PORT & _BV(LCD_DATA2_PIN)) b |= 0x04;
+    if (LCD_DATA3_PORT & _BV(LCD_DATA3_PIN)) b |= 0x08;
+#if LCD_DATA_BITS == 8
+    if (LCD_DATA4_PORT & _BV(LCD_DATA4_PIN)) b |= 0x10;
+    if (LCD_DATA5_PORT & _BV(LCD_DATA5_PIN)) b |= 0x20;
+    if (LCD_DATA6_PORT & _BV(LCD_DATA6_PIN)) b |= 0x40;
+    if (LCD_DATA7_PORT & _BV(LCD_DATA7_PIN)) b |= 0x80;
+#endif
+    return b;
+}
+
+
+static void pin_drive(volatile uint8_t *pin, uint8_t bit, uint8_t on)
+{
+    if (on)
+        *pin |= _BV(bit);
+    else
+        *pin &= ~_BV(bit);
+}
+
+
+/* put a value on the data lines for the firmware to read */
+static void bus_drive(uint8_t b)
+{
+    pin_drive(&PIN(LCD_DATA0_PORT), LCD_DATA0_PIN, b & 0x01);
+    pin_drive(&PIN(LCD_DATA1_PORT), LCD_DATA1_PIN, b & 0x02);
+    pin_drive(&PIN(LCD_DATA2_PORT), LCD_DATA2_PIN, b & 0x04);
+    pin_drive(&PIN(LCD_DATA3_PORT), LCD_DATA3_PIN, b & 0x08);
+#if LCD_DATA_BITS == 8
+    pin_drive(&PIN(LCD_DATA4_PORT), LCD_DATA4_PIN, b & 0x10);
+    pin_drive(&PIN(LCD_DATA5_PORT), LCD_DATA5_PIN, b & 0x20);
+    pin_drive(&PIN(LCD_DATA6_PORT), LCD_DATA6_PIN, b & 0x40);
+    pin_drive(&PIN(LCD_DATA7_PORT), LCD_DATA7_PIN, b & 0x80);
+#endif
+}
+
+
+static void lcd_strobe(struct hd44780 *c, uint8_t rs, uint8_t rw)
+{
+    uint8_t b = bus_sample();
+
+    if (rw) {
+        uint8_t v;
+
+        /* the status of the first half is latched for the second one */
+        if (!c->read_nibble)
+            c->latch = lcd_read_byte(c, rs);
+        v = c->latch;
+        if (LCD_DATA_BITS == 4 && !c->dl) {
+            c->read_nibble ^= 1;
+            v = c->read_nibble ? v >> 4 : v & 0x0F;
+        }
+        if (!c->read_nibble)
+            sim_lcd.reads++;
+        bus_drive(v);
+        return;
+    }
+    c->read_nibble = 0;
+
+    if (LCD_DATA_BITS == 4) {
+        if (c->dl) {
+            /* 8 bit interface on the upper four lines only */
+            b <<= 4;
+        } else if (!c->nibble) {
+            c->latch = b << 4;
+            c->nibble = 1;
+            return;
+        } else {
+            b |= c->latch;
+            c->nibble = 0;
+        }
+    }
+
+    if (sim_trace)
+        printf("%10.1f us  E%u %s 0x%02x%s\n", sim_now * 1000000.0 / F_CPU,
+               (unsigned)(c - ctl) + 1, rs ? "data" : "inst", b,
+               sim_now < c->busy_until ? "  ignored, busy" : "");
+
+    if (sim_now < c->busy_until) {
+        sim_lcd.ignored++;
+        return;
+    }
+
+    if (rs)
+        lcd_write_data(c, b);
+    else
+        lcd_instruction(c, b);
+}
+
+
+void sim_lcd_strobe(void)
+{
+    uint8_t rs = (LCD_RS_PORT & _BV(LCD_RS_PIN)) != 0;
+    uint8_t rw = (LCD_RW_PORT & _BV(LCD_RW_PIN)) != 0;
+    uint8_t i;
+
+    if (!initialized) {
+        for (i = 0; i < SIM_CONTROLLERS; i++)
+            lcd_reset(&ctl[i]);
+        initialized = 1;
+    }
+
+    sim_advance(SIM_CYCLES_STROBE);
+
+    if (LCD_E_PORT & _BV(LCD_E_PIN))
+        lcd_strobe(&ctl[0], rs, rw);
+#ifdef LCD_E2_PIN
+    if (LCD_E2_PORT & _BV(LCD_E2_PIN))
+        lcd_strobe(&ctl[1], rs, rw);
+#endif
+}
+
+
+/* DDRAM address of a visible position */
+static uint8_t lcd_address(struct hd44780 *c, uint8_t row, uint8_t col)
+{
+    uint8_t width = c->lines2 ? 40 : 80;
+    uint8_t pos;
+
+    if (sim_lcd_ks0073 && c->nw)
+        return (row * 0x20 + col) & 0x7F;
+
+    /* one line panel in two line mode: split addressing, 16x1 wired as 8x2 */
+    if (lcd_lines == 1 && c->lines2 && col >= lcd_disp_length / 2)
+        return 0x40 + (col - lcd_disp_length / 2 + c->offset) % width;
+
+    /* rows 3 and 4 of a HD44780 continue rows 1 and 2 */
+    pos = (col + (row >= 2 ? lcd_disp_length : 0) + c->offset) % width;
+    return ((row & 1) && c->lines2 ? 0x40 : 0x00) + pos;
+}
+
+
+void sim_lcd_print(void)
+{
+    uint8_t rows = lcd_lines;
+    uint8_t cols = lcd_disp_length;
+    uint8_t r, x, i;
+
+    printf("screen (%ux%u):\n  +", cols, rows);
+    for (x = 0; x < cols; x++)
+        putchar('-');
+    printf("+\n");
+
+    for (r = 0; r < rows; r++) {
+        struct hd44780 *c = &ctl[0];
+        uint8_t row = r;
+
+        if (SIM_CONTROLLERS > 1 && r >= 2) {
+            c = &ctl[SIM_CONTROLLERS - 1];
+            row = r - 2;
+        }
+
+        printf("  |");
+        for (x = 0; x < cols; x++) {
+            uint8_t ch = c->ddram[lcd_address(c, row, x)];
+            if (!c->display)
+                ch = ' ';
+            else if (ch < 16)
+                ch = '*';                /* custom character */
+            else if (ch < 0x20 || ch >= 0x7F)
+                ch = '?';
+            putchar(ch);
+        }
+        printf("|\n");
+    }
+
+    printf("  +");
+    for (x = 0; x < cols; x++)
+        putchar('-');
+    printf("+\n");
+
+    for (i = 0; i < SIM_CONTROLLERS; i++)
+        if (!ctl[i].display)
+            printf("  (controller %u: display off)\n", i + 1);
+}
@@ -0,0 +1,37 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * EEMEM variables live in RAM and start with their .eep contents. Writes
+ * cost the 3.4ms programming time of the real EEPROM.
+ */
+
+#ifndef SIM_AVR_EEPROM_H
+#define SIM_AVR_EEPROM_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define EEMEM
+
+uint8_t eeprom_read_byte(const uint8_t *p);
+void    eeprom_write_byte(uint8_t *p, uint8_t value);
+void    eeprom_update_byte(uint8_t *p, uint8_t value);
+void    eeprom_read_block(void *dst, const void *src, size_t n);
+void    eeprom_write_block(const void *src, void *dst, size_t n);
+void    eeprom_update_block(const void *src, void *dst, size_t n);
+int     eeprom_is_ready(void);
+
+#endif /* SIM_AVR_EEPROM_H */
@@ -0,0 +1,32 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Interrupt handlers become plain functions that the simulator calls when
+ * the bus has something for them and the global interrupt flag is set.
+ */
+
+#ifndef SIM_AVR_INTERRUPT_H
+#define SIM_AVR_INTERRUPT_H
+
+#define ISR(vector)  void vector(void)
+
+void sim_sei(void);
+void sim_cli(void);
+
+#define sei()  sim_sei()
+#define cli()  sim_cli()
+
+#endif /* SIM_AVR_INTERRUPT_H */
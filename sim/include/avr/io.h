@@ -0,0 +1,164 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * ATtiny2313/4313 I/O registers for the host build.
+ *
+ * The registers are plain bytes at their I/O addresses in sim_io[], so the
+ * DDR(x) and PIN(x) macros of the LCD driver (&PORTx - 1, &PORTx - 2) keep
+ * working. The simulator looks at the pins when something happens on the
+ * bus (E strobe, I2C byte), it does not trace every register access. UCSRA
+ * and UDR are functions, so that the UART model sees the bytes sent.
+ */
+
+#ifndef SIM_AVR_IO_H
+#define SIM_AVR_IO_H
+
+#include <stdint.h>
+
+extern volatile uint8_t sim_io[0x40];
+uint16_t sim_tcnt1(void);
+volatile uint8_t *sim_ucsra(void);
+volatile uint8_t *sim_udr(void);
+
+#define _SFR_IO8(addr)  sim_io[(addr)]
+#define _BV(bit)        (1 << (bit))
+
+#define DIDR    _SFR_IO8(0x01)
+#define UBRRH   _SFR_IO8(0x02)
+#define UCSRC   _SFR_IO8(0x03)
+#define ACSR    _SFR_IO8(0x08)
+#define UBRRL   _SFR_IO8(0x09)
+#define UCSRB   _SFR_IO8(0x0A)
+#define UCSRA   (*sim_ucsra())              /* UDRE always set, see sim/uart.c */
+#define UDR     (*sim_udr())                /* received byte or byte to send */
+#define USICR   _SFR_IO8(0x0D)
+#define USISR   _SFR_IO8(0x0E)
+#define USIDR   _SFR_IO8(0x0F)
+#define PIND    _SFR_IO8(0x10)
+#define DDRD    _SFR_IO8(0x11)
+#define PORTD   _SFR_IO8(0x12)
+#define GPIOR0  _SFR_IO8(0x13)
+#define GPIOR1  _SFR_IO8(0x14)
+#define GPIOR2  _SFR_IO8(0x15)
+#define PINB    _SFR_IO8(0x16)
+#define DDRB    _SFR_IO8(0x17)
+#define PORTB   _SFR_IO8(0x18)
+#define PINA    _SFR_IO8(0x19)
+#define DDRA    _SFR_IO8(0x1A)
+#define PORTA   _SFR_IO8(0x1B)
+#define EECR    _SFR_IO8(0x1C)
+#define EEDR    _SFR_IO8(0x1D)
+#define EEAR    _SFR_IO8(0x1E)
+#define WDTCSR  _SFR_IO8(0x21)
+#define ICR1    _SFR_IO8(0x24)
+#define OCR1B   _SFR_IO8(0x28)
+#define OCR1A   _SFR_IO8(0x2A)
+#define TCNT1   sim_tcnt1()                /* free running, read only */
+#define TCCR1B  _SFR_IO8(0x2E)
+#define TCCR1A  _SFR_IO8(0x2F)
+#define TCCR0A  _SFR_IO8(0x30)
+#define TCNT0   _SFR_IO8(0x32)
+#define TCCR0B  _SFR_IO8(0x33)
+#define MCUCR   _SFR_IO8(0x35)
+#define OCR0A   _SFR_IO8(0x36)
+#define TIFR    _SFR_IO8(0x38)
+#define TIMSK   _SFR_IO8(0x39)
+#define GIFR    _SFR_IO8(0x3A)
+#define GIMSK   _SFR_IO8(0x3B)
+#define OCR0B   _SFR_IO8(0x3C)
+#define SREG    _SFR_IO8(0x3F)
+
+/* port pins */
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PINB5 5
+#define PINB7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+
+/* USICR */
+#define USISIE 7
+#define USIOIE 6
+#define USIWM1 5
+#define USIWM0 4
+#define USICS1 3
+#define USICS0 2
+#define USICLK 1
+#define USITC  0
+
+/* USISR */
+#define USISIF  7
+#define USIOIF  6
+#define USIPF   5
+#define USIDC   4
+#define USICNT0 0
+
+/* TCCR0A, TCCR0B */
+#define COM0A1 7
+#define COM0A0 6
+#define COM0B1 5
+#define COM0B0 4
+#define WGM01  1
+#define WGM00  0
+#define WGM02  3
+#define CS02   2
+#define CS01   1
+#define CS00   0
+
+/* TCCR1A, TCCR1B */
+#define COM1A1 7
+#define COM1A0 6
+#define COM1B1 5
+#define COM1B0 4
+#define WGM11  1
+#define WGM10  0
+#define WGM13  4
+#define WGM12  3
+#define CS12   2
+#define CS11   1
+#define CS10   0
+
+/* UCSRA, UCSRB, UCSRC */
+#define RXC    7
+#define TXC    6
+#define UDRE   5
+#define U2X    1
+#define RXCIE  7
+#define RXEN   4
+#define TXEN   3
+#define UCSZ1  2
+#define UCSZ0  1
+
+/* interrupt vectors, see avr/interrupt.h */
+#define USI_START_vect      sim_usi_start_vect
+#define USI_OVERFLOW_vect   sim_usi_overflow_vect
+#define USART_RX_vect       sim_usart_rx_vect
+
+#endif /* SIM_AVR_IO_H */
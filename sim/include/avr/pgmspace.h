@@ -0,0 +1,28 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/* program memory is ordinary memory on the host */
+
+#ifndef SIM_AVR_PGMSPACE_H
+#define SIM_AVR_PGMSPACE_H
+
+#include <stdint.h>
+
+#define PROGMEM
+#define PSTR(s)            (s)
+#define pgm_read_byte(p)   (*(const uint8_t *)(p))
+#define pgm_read_word(p)   (*(const uint16_t *)(p))
+
+#endif /* SIM_AVR_PGMSPACE_H */
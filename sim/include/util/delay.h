@@ -0,0 +1,35 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/* busy waits advance the simulated clock */
+
+#ifndef SIM_UTIL_DELAY_H
+#define SIM_UTIL_DELAY_H
+
+#include <stdint.h>
+
+void sim_advance(uint32_t cycles);
+
+static inline void _delay_us(double us)
+{
+    sim_advance((uint32_t)(us * (F_CPU / 1000000.0)));
+}
+
+static inline void _delay_ms(double ms)
+{
+    sim_advance((uint32_t)(ms * (F_CPU / 1000.0)));
+}
+
+#endif /* SIM_UTIL_DELAY_H */
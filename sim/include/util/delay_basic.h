@@ -0,0 +1,35 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/* counted delay loops, 3 and 4 cycles per round as on the AVR */
+
+#ifndef SIM_UTIL_DELAY_BASIC_H
+#define SIM_UTIL_DELAY_BASIC_H
+
+#include <stdint.h>
+
+void sim_advance(uint32_t cycles);
+
+static inline void _delay_loop_1(uint8_t count)
+{
+    sim_advance(3 * (count ? count : 256));
+}
+
+static inline void _delay_loop_2(uint16_t count)
+{
+    sim_advance(4 * (count ? count : 65536UL));
+}
+
+#endif /* SIM_UTIL_DELAY_BASIC_H */
@@ -0,0 +1,584 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Simulated clock, script reader and report.
+ *
+ * The script is a list of I2C transactions, one per line:
+ *
+ *   w 0x82                   write transaction (hex, decimal, 'c' or "text")
+ *   "Hello"                  same as w "Hello"
+ *   r 1                      read transaction of 1 byte
+ *   idle 1000                bus idle time in us before the next transaction
+ *   addr 50                  slave address of the following transactions
+ *   speed 400000             SCL frequency of the following transactions
+ *   u "Hello"                bytes sent on the UART (FEATURE_UART), see uart.c
+ *   # comment
+ *
+ * The master starts sending after the boot time (-b, 2.5s by default, when the
+ * startup address display is over) and
+ * the simulation ends when the script has been sent and the firmware is
+ * idle. Times and LCD statistics in the report are counted from the first
+ * transaction.
+ */
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include "usiTwiSlave.h"
+#include "ready.h"
+
+#undef main
+
+#define SIM_MAX_LINE   1024
+
+volatile uint8_t sim_io[0x40];
+
+uint64_t sim_now;
+uint64_t sim_idle;
+uint8_t  sim_i;
+uint8_t  sim_trace;
+uint8_t  sim_metrics;
+
+static struct sim_transaction *script;
+static uint16_t script_len;
+static struct sim_transaction *uart_script;
+static uint16_t uart_len;
+static uint8_t  bus_started;
+static uint32_t boot_ms = 2500;
+static uint64_t origin;              /* cycle of the first transaction */
+static uint64_t origin_idle;
+
+static uint64_t eeprom_ready;
+
+/* processing time per command, indexed by the first byte (0: text) */
+struct command_stats {
+    uint32_t count;
+    uint64_t total;
+    uint32_t max;
+};
+
+static struct command_stats commands[256];
+static uint8_t  cmd_open;
+static uint8_t  cmd_op;
+static uint64_t cmd_start;
+static uint64_t cmd_idle;
+
+void firmware_main(void);
+
+
+/*
+** clock
+*/
+
+static void command_close(void)
+{
+    struct command_stats *s = &commands[cmd_op];
+    uint32_t busy;
+
+    if (!cmd_open)
+        return;
+
+    busy = (sim_now - cmd_start) - (sim_idle - cmd_idle);
+    s->count++;
+    s->total += busy;
+    if (busy > s->max)
+        s->max = busy;
+    cmd_open = 0;
+}
+
+
+/* charge the bytes the firmware took from the RX buffer since the last call */
+static void account(void)
+{
+    uint16_t line;
+    uint8_t first, value;
+
+    while (sim_bus_consumed(&line, &first, &value)) {
+        if (first) {
+            command_close();
+            cmd_open = 1;
+            cmd_op = value >= 0x80 ? value : 0;
+            cmd_start = sim_now;
+            cmd_idle = sim_idle;
+        }
+        sim_now += SIM_CYCLES_BYTE;
+    }
+}
+
+
+/* cycle of the next event on the bus or the UART, UINT64_MAX if none */
+static uint64_t next_due(void)
+{
+    uint64_t due = sim_bus_pending() ? sim_bus_due() : UINT64_MAX;
+
+    if (sim_uart_pending() && sim_uart_due() < due)
+        due = sim_uart_due();
+    return due;
+}
+
+
+static void step(void)
+{
+    if (!origin) {
+        origin = sim_now;
+        origin_idle = sim_idle;
+        memset(&sim_lcd, 0, sizeof(sim_lcd));   /* count from here, like the time */
+    }
+    if (sim_uart_pending() && (!sim_bus_pending() || sim_uart_due() < sim_bus_due()))
+        sim_uart_step();
+    else
+        sim_bus_step();
+}
+
+
+/* log the ready line when it changes (FEATURE_READY) */
+static void ready_watch(void)
+{
+#ifdef FEATURE_READY
+    static uint8_t low;
+
+    if (!!(READY_DDR & _BV(READY_PIN)) != low) {
+        low = !low;
+        if (sim_trace)
+            printf("%10.1f us  ready %s\n", sim_now * 1000000.0 / F_CPU, low ? "low" : "high");
+    }
+#endif
+}
+
+
+/* the firmware spends <cycles>, interrupts are served in between */
+void sim_advance(uint32_t cycles)
+{
+    uint64_t target;
+
+    sim_bus_poll();
+    sim_uart_poll();
+    account();
+    ready_watch();
+    target = sim_now + cycles;
+
+    while (bus_started && sim_i && next_due() <= target) {
+        uint64_t before;
+
+        if (next_due() > sim_now)
+            sim_now = next_due();
+        before = sim_now;
+        step();
+        target += sim_now - before;          /* time taken by the ISRs */
+    }
+    sim_now = target;
+}
+
+
+/* the firmware has nothing to do until the bus or the UART delivers */
+void sim_twi_wait(void)
+{
+    sim_bus_poll();
+    sim_uart_poll();
+    account();
+    ready_watch();
+
+#ifdef FEATURE_READY
+    /* the ready line waits for the EEPROM, let the firmware see it finish */
+    if (!eeprom_is_ready() && next_due() > eeprom_ready) {
+        sim_idle += eeprom_ready - sim_now;
+        sim_now = eeprom_ready;
+        return;
+    }
+#endif
+
+    if (!bus_started || !sim_i || (!sim_bus_pending() && !sim_uart_pending()))
+        sim_finish();
+
+    if (next_due() == UINT64_MAX) {
+        printf("deadlock: the firmware waits for the bus and holds SCL low\n");
+        sim_finish();
+    }
+
+    if (next_due() > sim_now) {
+        sim_idle += next_due() - sim_now;
+        sim_now = next_due();
+    }
+    step();
+}
+
+
+void sim_sei(void)
+{
+    sim_i = 1;
+    if (!bus_started) {
+        uint64_t boot = (uint64_t)boot_ms * (F_CPU / 1000);
+        bus_started = 1;
+        sim_bus_start(script, script_len, sim_now > boot ? sim_now : boot);
+        sim_uart_start(uart_script, uart_len, sim_now > boot ? sim_now : boot);
+    }
+}
+
+
+void sim_cli(void)
+{
+    sim_i = 0;
+}
+
+
+/* Timer1 in normal mode, counting with the prescaler set in TCCR1B */
+uint16_t sim_tcnt1(void)
+{
+    static const uint16_t prescaler[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+    uint16_t div = prescaler[TCCR1B & 0x07];
+
+    return div ? sim_now / div : 0;
+}
+
+
+/*
+** avr-libc functions
+*/
+
+static void eeprom_wait(void)
+{
+    if (sim_now < eeprom_ready)
+        sim_advance(eeprom_ready - sim_now);
+}
+
+
+int eeprom_is_ready(void)
+{
+    return sim_now >= eeprom_ready;
+}
+
+
+uint8_t eeprom_read_byte(const uint8_t *p)
+{
+    eeprom_wait();
+    return *p;
+}
+
+
+void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+    eeprom_wait();
+    *p = value;
+    eeprom_ready = sim_now + (uint64_t)SIM_US_EEPROM_WRITE * (F_CPU / 1000000);
+}
+
+
+void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+    if (eeprom_read_byte(p) != value)
+        eeprom_write_byte(p, value);
+}
+
+
+void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    while (n--)
+        *(uint8_t *)dst++ = eeprom_read_byte(src++);
+}
+
+
+void eeprom_write_block(const void *src, void *dst, size_t n)
+{
+    while (n--)
+        eeprom_write_byte(dst++, *(const uint8_t *)src++);
+}
+
+
+void eeprom_update_block(const void *src, void *dst, size_t n)
+{
+    while (n--)
+        eeprom_update_byte(dst++, *(const uint8_t *)src++);
+}
+
+
+char *itoa(int value, char *s, int radix)
+{
+    char buf[18];
+    char *p = buf;
+    char *r = s;
+    unsigned int v = value;
+
+    if (value < 0 && radix == 10) {
+        *r++ = '-';
+        v = -value;
+    }
+    do {
+        *p++ = "0123456789abcdef"[v % radix];
+        v /= radix;
+    } while (v);
+    while (p > buf)
+        *r++ = *--p;
+    *r = 0;
+    return s;
+}
+
+
+/*
+** script
+*/
+
+static void script_error(uint16_t line, const char *msg)
+{
+    fprintf(stderr, "script line %u: %s\n", line, msg);
+    exit(2);
+}
+
+
+/* parse the bytes of a write transaction */
+static uint16_t parse_bytes(char *p, uint8_t *out, uint16_t line)
+{
+    uint16_t n = 0;
+
+    while (*p) {
+        if (isspace((unsigned char)*p)) {
+            p++;
+        } else if (*p == '"' || *p == '\'') {
+            char quote = *p++;
+            while (*p && *p != quote) {
+                uint8_t c = *p++;
+                if (c == '\\' && *p) {
+                    c = *p++;
+                    if (c == 'n') c = '\n';
+                    else if (c == 'r') c = '\r';
+                    else if (c == 'x') c = strtoul(p, &p, 16);
+                }
+                out[n++] = c;
+            }
+            if (*p != quote)
+                script_error(line, "unterminated string");
+            p++;
+        } else {
+            char *end;
+            unsigned long v = strtoul(p, &end, 0);
+            if (end == p || v > 0xFF)
+                script_error(line, "bad byte");
+            out[n++] = v;
+            p = end;
+        }
+    }
+    return n;
+}
+
+
+static void script_read(FILE *f, uint8_t address, uint32_t bus_hz)
+{
+    char buf[SIM_MAX_LINE];
+    uint8_t data[SIM_MAX_LINE];
+    uint32_t idle_us = 0;
+    uint16_t line = 0;
+
+    while (fgets(buf, sizeof(buf), f)) {
+        struct sim_transaction *t;
+        char *p = buf;
+        char *arg;
+
+        line++;
+        while (isspace((unsigned char)*p))
+            p++;
+        if (!*p || *p == '#')
+            continue;
+
+        arg = p;
+        while (*arg && !isspace((unsigned char)*arg) && *arg != '"' && *arg != '\'')
+            arg++;
+
+        if (!strncmp(p, "idle", arg - p) && arg - p == 4) {
+            idle_us += strtoul(arg, NULL, 0);
+            continue;
+        } else if (!strncmp(p, "addr", arg - p) && arg - p == 4) {
+            address = strtoul(arg, NULL, 0);
+            continue;
+        } else if (!strncmp(p, "speed", arg - p) && arg - p == 5) {
+            bus_hz = strtoul(arg, NULL, 0);
+            continue;
+        }
+
+        if (*p == 'u' && arg - p == 1) {
+#ifndef FEATURE_UART
+            script_error(line, "u needs a build with FEATURE_UART=YES");
+#endif
+            uart_script = realloc(uart_script, (uart_len + 1) * sizeof(*uart_script));
+            t = &uart_script[uart_len++];
+        } else {
+            script = realloc(script, (script_len + 1) * sizeof(*script));
+            t = &script[script_len++];
+        }
+        t->address = address;
+        t->bus_hz = bus_hz;
+        t->idle_us = idle_us;
+        t->line = line;
+        t->data = NULL;
+        idle_us = 0;
+
+        if (*p == 'r' && arg - p == 1) {
+            t->type = SIM_BUS_READ;
+            t->length = strtoul(arg, NULL, 0);
+        } else {
+            t->type = SIM_BUS_WRITE;
+            if (*p == 'u' && arg - p == 1)
+                t->type = SIM_UART_WRITE;
+            if ((*p == 'w' || *p == 'u') && arg - p == 1)
+                p = arg;
+            t->length = parse_bytes(p, data, line);
+            t->data = malloc(t->length);
+            memcpy(t->data, data, t->length);
+        }
+        if (!t->length)
+            script_error(line, "empty transaction");
+    }
+}
+
+
+/*
+** report
+*/
+
+#define MS(cycles)  ((double)(cycles) * 1000.0 / F_CPU)
+#define US(cycles)  ((double)(cycles) * 1000000.0 / F_CPU)
+
+/* the numbers watched by the bench, lower is better for all of them */
+static void print_metrics(uint64_t busy)
+{
+    unsigned i;
+
+    printf("busy_cycles %llu\n", (unsigned long long)busy);
+    printf("isr_start_latency %u\n", sim_bus.start_latency);
+    printf("isr_overflow_latency %u\n", sim_bus.overflow_latency);
+    printf("waitbusy_cycles %llu\n", (unsigned long long)sim_lcd.wait_cycles);
+    printf("rx_high_water %u\n", sim_bus.rx_high_water);
+    printf("longest_stretch %llu\n", (unsigned long long)sim_bus.longest_stretch);
+    printf("rx_dropped %u\n", sim_bus.dropped);
+    printf("tx_underruns %u\n", sim_bus.underruns);
+    printf("lcd_ignored %u\n", sim_lcd.ignored);
+    printf("lcd_stale_reads %u\n", sim_lcd.stale_reads);
+    for (i = 0; i < 256; i++) {
+        struct command_stats *s = &commands[i];
+        char name[8];
+
+        if (!s->count)
+            continue;
+        if (i)
+            sprintf(name, "0x%02x", i);
+        else
+            strcpy(name, "text");
+        printf("cmd_%s_avg %llu\n", name, (unsigned long long)(s->total / s->count));
+        printf("cmd_%s_max %u\n", name, s->max);
+    }
+}
+
+
+void sim_finish(void)
+{
+    unsigned i;
+    uint64_t elapsed = sim_now - origin;
+    uint64_t busy = elapsed - (sim_idle - origin_idle);
+
+    sim_uart_poll();
+    command_close();
+
+    if (sim_metrics) {
+        print_metrics(busy);
+        exit(0);
+    }
+
+    printf("time: %.3f ms (%llu cycles), %.3f ms busy\n",
+           MS(elapsed), (unsigned long long)elapsed, MS(busy));
+    printf("bus: %u transactions, %u bytes written, %u read, %u nacked, %u tx underruns\n",
+           sim_bus.transactions, sim_bus.written, sim_bus.read, sim_bus.nacked, sim_bus.underruns);
+    printf("rx buffer: %u bytes dropped in %u overruns, high water %u of %u\n",
+           sim_bus.dropped, sim_bus.overruns, sim_bus.rx_high_water, TWI_RX_BUFFER_SIZE - 1);
+    printf("isr latency: %u cycles start condition, %u cycles counter overflow\n",
+           sim_bus.start_latency, sim_bus.overflow_latency);
+    printf("clock stretching: %u times, longest %.1f us\n",
+           sim_bus.stretches, US(sim_bus.longest_stretch));
+    if (uart_len)
+        printf("uart: %u bytes received, %u lost, %u sent\n",
+               sim_uart.received, sim_uart.lost, sim_uart.sent);
+    printf("lcd: %u instructions, %u data, %u reads, %u busy polls, %u ignored while busy\n",
+           sim_lcd.instructions, sim_lcd.data, sim_lcd.reads, sim_lcd.busy_polls, sim_lcd.ignored);
+    printf("lcd: %.3f ms waiting for the busy flag\n", MS(sim_lcd.wait_cycles));
+    if (sim_lcd.stale_reads)
+        printf("lcd: %u data reads after a write with no address set, they returned junk\n",
+               sim_lcd.stale_reads);
+
+    printf("commands:\n  op     count    avg cycles    max cycles      avg us\n");
+    for (i = 0; i < 256; i++) {
+        struct command_stats *s = &commands[i];
+        if (!s->count)
+            continue;
+        if (i)
+            printf("  0x%02x", i);
+        else
+            printf("  text");
+        printf(" %7u %13llu %13u %11.1f\n", s->count,
+               (unsigned long long)(s->total / s->count), s->max, US(s->total / s->count));
+    }
+
+    sim_lcd_print();
+    exit(0);
+}
+
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "usage: %s [-a address] [-s bus_hz] [-b boot_ms] [-k] [-t] [-m] [script]\n"
+            "  -a  slave address (default 50)\n"
+            "  -s  SCL frequency (default 100000)\n"
+            "  -b  time before the first transaction (default 2500)\n"
+            "  -k  attach a KS0073 instead of a HD44780\n"
+            "  -t  trace the transfers on the LCD bus\n"
+            "  -m  print the results as \"name value\" lines (see bench.sh)\n"
+            "The script is read from stdin when no file is given.\n", name);
+    exit(2);
+}
+
+
+int main(int argc, char **argv)
+{
+    uint8_t address = 50;
+    uint32_t bus_hz = 100000;
+    FILE *f = stdin;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "a:s:b:ktmh")) != -1) {
+        switch (opt) {
+        case 'a': address = strtoul(optarg, NULL, 0); break;
+        case 's': bus_hz = strtoul(optarg, NULL, 0); break;
+        case 'b': boot_ms = strtoul(optarg, NULL, 0); break;
+        case 'k': sim_lcd_ks0073 = 1; break;
+        case 't': sim_trace = 1; break;
+        case 'm': sim_metrics = 1; break;
+        default:  usage(argv[0]);
+        }
+    }
+    if (optind < argc && !(f = fopen(argv[optind], "r"))) {
+        perror(argv[optind]);
+        return 2;
+    }
+
+    script_read(f, address, bus_hz);
+
+    /* idle bus: SDA and SCL high */
+    PINB |= _BV(PB5) | _BV(PB7);
+
+    firmware_main();
+    return 0;
+}
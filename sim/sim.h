@@ -0,0 +1,151 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Included in front of every source file of the host build (gcc -include).
+ *
+ * Time only moves at the points where the firmware waits: delay loops, E
+ * strobes on the LCD bus and the idle hook of the TWI driver. The code in
+ * between runs in zero time, except for a fixed cost per received byte.
+ * The numbers below are estimates taken from the avr-gcc -Os listings.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdint.h>
+
+#ifndef __AVR_ATtiny4313__
+#define __AVR_ATtiny4313__ 1
+#endif
+
+#define SIM_CYCLES_STROBE      16    /* pin setup and E pulse of one LCD bus transfer */
+#define SIM_CYCLES_BYTE        40    /* fetching and dispatching one received byte */
+#define SIM_CYCLES_ISR_START   40    /* ISR(USI_START_VECTOR) incl. entry and exit */
+#define SIM_CYCLES_ISR_OVF     45    /* ISR(USI_OVERFLOW_VECTOR) incl. entry and exit */
+#define SIM_CYCLES_ISR_UART    35    /* ISR(USART_RX_vect) incl. entry and exit */
+#define SIM_US_EEPROM_WRITE    3400  /* EEPROM erase and write */
+
+/* hooks called by the firmware, see lcd.c, usiTwiSlave.h and uart.h */
+#define lcd_e_delay()   sim_lcd_strobe();
+#define USI_TWI_WAIT()  sim_twi_wait()
+
+#define UART_WAIT()     sim_twi_wait()
+
+void sim_lcd_strobe(void);
+void sim_twi_wait(void);
+
+#ifdef FEATURE_UART
+/* the UART takes PD0/PD1, the simulated board has the LCD on other pins */
+#define LCD_PORT         PORTD
+#define LCD_DATA0_PORT   PORTD
+#define LCD_DATA1_PORT   PORTD
+#define LCD_DATA2_PORT   PORTD
+#define LCD_DATA3_PORT   PORTD
+#define LCD_DATA0_PIN    2
+#define LCD_DATA1_PIN    3
+#define LCD_DATA2_PIN    4
+#define LCD_DATA3_PIN    5
+#define LCD_RS_PORT      PORTA
+#define LCD_RS_PIN       0
+#define LCD_RW_PORT      PORTA
+#define LCD_RW_PIN       1
+#define LCD_E_PORT       PORTD
+#define LCD_E_PIN        6
+#endif
+
+/* not part of glibc */
+char *itoa(int value, char *s, int radix);
+
+/* sim.c: clock */
+extern uint64_t sim_now;             /* cycles since reset */
+extern uint64_t sim_idle;            /* cycles spent waiting for the bus */
+extern uint8_t  sim_i;               /* global interrupt flag */
+extern uint8_t  sim_trace;           /* log every LCD transfer */
+extern uint8_t  sim_metrics;         /* report as "name value" lines for the bench */
+void sim_advance(uint32_t cycles);
+void sim_finish(void);
+
+/* usi.c: I2C master driving the USI */
+#define SIM_BUS_WRITE  0
+#define SIM_BUS_READ   1
+#define SIM_UART_WRITE 2             /* bytes sent on the UART (FEATURE_UART) */
+
+struct sim_transaction {
+    uint8_t   type;                  /* SIM_BUS_WRITE or SIM_BUS_READ */
+    uint8_t   address;               /* 7 bit slave address */
+    uint32_t  bus_hz;                /* SCL frequency */
+    uint32_t  idle_us;               /* bus idle time before the start condition */
+    uint16_t  length;                /* bytes to write or read */
+    uint8_t  *data;                  /* bytes to write */
+    uint16_t  line;                  /* script line */
+};
+
+struct sim_bus_stats {
+    uint32_t transactions;
+    uint32_t written;                /* bytes acknowledged by the slave */
+    uint32_t read;
+    uint32_t nacked;                 /* transactions aborted by a NACK */
+    uint32_t underruns;              /* reads while the TX buffer was empty */
+    uint32_t dropped;                /* received bytes lost to RX buffer overruns */
+    uint32_t overruns;
+    uint8_t  rx_high_water;
+    uint32_t start_latency;          /* worst case cycles from the start condition to its ISR */
+    uint32_t overflow_latency;       /* worst case cycles from the counter overflow to its ISR */
+    uint32_t stretches;              /* times the firmware held SCL low after its ISR */
+    uint64_t longest_stretch;        /* cycles */
+};
+
+extern struct sim_bus_stats sim_bus;
+
+void     sim_bus_start(struct sim_transaction *t, uint16_t n, uint64_t at);
+int      sim_bus_pending(void);      /* transactions left to send */
+uint64_t sim_bus_due(void);          /* cycle of the next bus event */
+void     sim_bus_step(void);         /* run the next bus event */
+void     sim_bus_poll(void);         /* continue after SCL held by the firmware is released */
+uint8_t  sim_bus_consumed(uint16_t *line, uint8_t *first, uint8_t *value); /* next byte taken by the firmware */
+
+/* uart.c: host on the UART (FEATURE_UART) */
+struct sim_uart_stats {
+    uint32_t received;               /* bytes passed to the RX interrupt */
+    uint32_t lost;                   /* bytes that came while the receiver was off */
+    uint32_t sent;                   /* bytes written to UDR */
+};
+
+extern struct sim_uart_stats sim_uart;
+
+void     sim_uart_start(struct sim_transaction *t, uint16_t n, uint64_t at);
+int      sim_uart_pending(void);     /* bytes left to send */
+uint64_t sim_uart_due(void);         /* cycle of the next received byte */
+void     sim_uart_step(void);        /* receive the next byte */
+void     sim_uart_poll(void);        /* print a byte the firmware has sent */
+
+/* hd44780.c: display controller model */
+struct sim_lcd_stats {
+    uint32_t instructions;
+    uint32_t data;
+    uint32_t reads;
+    uint32_t busy_polls;             /* status reads that returned busy */
+    uint32_t ignored;                /* transfers while the controller was busy */
+    uint32_t stale_reads;            /* data reads after a write with no address set */
+    uint64_t wait_cycles;            /* from the first busy status read to the last one */
+};
+
+extern struct sim_lcd_stats sim_lcd;
+extern uint8_t sim_lcd_ks0073;       /* model a KS0073 instead of a HD44780 */
+
+void sim_lcd_print(void);
+
+#endif /* SIM_H */
@@ -0,0 +1,136 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * Host on the UART (FEATURE_UART). The bytes of the "u" lines of the
+ * script arrive one frame (10 bits at UART_BAUD) after the other and the
+ * RX interrupt is called for each, late when interrupts are off. The UART
+ * is timed on its own: a "u" line starts when the one before it has been
+ * sent, after the idle time in front of it, whatever the I2C bus does.
+ *
+ * Bytes the firmware writes to UDR are printed and take one frame each;
+ * a write waits while the transmitter still has a byte besides UDR, which
+ * is what the firmware's wait for UDRE does on the target. The commands
+ * that come in on the UART are not in the command statistics.
+ */
+
+#include <stdio.h>
+#include <avr/io.h>
+#include "uart.h"
+
+#ifndef UART_BAUD
+#define UART_BAUD      250000
+#endif
+
+#define FRAME_CYCLES   ((uint64_t)F_CPU * 10 / UART_BAUD)
+#define REG_UCSRA      0x0B
+#define REG_UDR        0x0C
+
+struct sim_uart_stats sim_uart;
+
+static struct sim_transaction *queue;
+static uint16_t queue_len;
+static uint16_t current;
+static uint16_t byte_index;          /* byte within the line */
+static uint64_t due;
+
+static uint8_t  in_isr;              /* UDR is read by the RX interrupt */
+static volatile uint8_t tx_data;     /* UDR as written by the firmware */
+static uint8_t  tx_written;
+static uint64_t tx_free;             /* cycle the transmitter is done */
+
+void USART_RX_vect(void);
+
+
+void sim_uart_start(struct sim_transaction *t, uint16_t n, uint64_t at)
+{
+    queue = t;
+    queue_len = n;
+    current = 0;
+    byte_index = 0;
+    if (n)
+        due = at + (uint64_t)t[0].idle_us * (F_CPU / 1000000);
+}
+
+
+int sim_uart_pending(void)
+{
+    return current < queue_len;
+}
+
+
+uint64_t sim_uart_due(void)
+{
+    return due;
+}
+
+
+void sim_uart_step(void)
+{
+    struct sim_transaction *t = &queue[current];
+
+    if ((UCSRB & _BV(RXEN)) && (UCSRB & _BV(RXCIE))) {
+        sim_io[REG_UDR] = t->data[byte_index];
+        sim_uart.received++;
+        sim_now += SIM_CYCLES_ISR_UART;
+        in_isr = 1;
+#ifdef FEATURE_UART
+        USART_RX_vect();
+#endif
+        in_isr = 0;
+    } else
+        sim_uart.lost++;
+
+    due += FRAME_CYCLES;
+    if (++byte_index == t->length) {
+        byte_index = 0;
+        if (++current < queue_len)
+            due += (uint64_t)queue[current].idle_us * (F_CPU / 1000000);
+    }
+}
+
+
+void sim_uart_poll(void)
+{
+    if (!tx_written)
+        return;
+
+    tx_written = 0;
+    sim_uart.sent++;
+    if (!sim_metrics)
+        printf("uart: sent 0x%02x\n", tx_data);
+}
+
+
+/* the transmitter is always ready, sim_udr() takes the time */
+volatile uint8_t *sim_ucsra(void)
+{
+    sim_io[REG_UCSRA] |= _BV(UDRE);
+    return &sim_io[REG_UCSRA];
+}
+
+
+volatile uint8_t *sim_udr(void)
+{
+    if (in_isr)
+        return &sim_io[REG_UDR];
+
+    sim_uart_poll();
+    if (tx_free > sim_now + FRAME_CYCLES)
+        sim_advance(tx_free - FRAME_CYCLES - sim_now);
+    tx_free = (tx_free > sim_now ? tx_free : sim_now) + FRAME_CYCLES;
+    tx_written = 1;
+    return &tx_data;
+}
@@ -0,0 +1,292 @@
+/*
+ * Host simulation of the TWI LCD controller
+ * (C) 2011 Akafugu Corporation
+ *
+ * This program is free software; you can redistribute it and/or modify it under the
+ * terms of the GNU General Public License as published by the Free Software
+ * Foundation; either version 2 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT ANY
+ * WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+ * PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+ *
+ */
+
+/*
+ * I2C master on byte level. Each transaction is cut into the events the USI
+ * raises on the target (start condition, counter overflow after a byte and
+ * after the acknowledge bit) and the firmware's ISRs are called for them.
+ *
+ * The USI holds SCL low until its interrupt has been served, so an event
+ * that is served late delays the rest of the transaction (clock stretching).
+ * The ISR releases SCL by writing 1 to USIOIF; when it returns without doing
+ * so, the bus stays held until the main program does (see sim_bus_poll).
+ *
+ * The driver is included here so its buffers can be inspected.
+ */
+
+#include <stdio.h>
+#include "usiTwiSlave.c"
+
+#define EV_START     0
+#define EV_ADDRESS   1
+#define EV_ADDR_ACK  2
+#define EV_BYTE      3
+#define EV_BYTE_ACK  4
+#define EV_STOP      5
+
+#define NEVER        UINT64_MAX
+
+struct sim_bus_stats sim_bus;
+
+static struct sim_transaction *queue;
+static uint16_t queue_len;
+static uint16_t current;
+static uint16_t byte_index;          /* byte within the transaction */
+static uint8_t  event = EV_STOP;
+static uint64_t due;
+static uint8_t  held;                /* event whose ISR left SCL low */
+static uint64_t held_since;
+
+/* script line and command start flag of each RX buffer slot */
+static uint16_t rx_line[ TWI_RX_BUFFER_SIZE ];
+static uint8_t  rx_first[ TWI_RX_BUFFER_SIZE ];
+static uint8_t  seen_tail;
+
+
+static uint32_t bit_cycles(void)
+{
+    return F_CPU / queue[current].bus_hz;
+}
+
+
+static uint8_t rx_count(void)
+{
+    return ( rxHead - rxTail ) & TWI_RX_BUFFER_MASK;
+}
+
+
+/* the event was due at <due>, its interrupt is served now */
+static void latency(uint32_t *worst)
+{
+    if ( sim_now - due > *worst )
+        *worst = sim_now - due;
+}
+
+
+/* returns 0 when the ISR kept SCL low, the event is then finished by sim_bus_poll */
+static uint8_t overflow_isr(void)
+{
+    if ( USICR & ( 1 << USIOIE ) )
+    {
+        latency( &sim_bus.overflow_latency );
+        sim_now += SIM_CYCLES_ISR_OVF;
+        USISR &= ~( 1 << USIOIF );       /* set by the hardware, reads as 0 here */
+        USI_OVERFLOW_VECTOR( );
+        if ( !( USISR & ( 1 << USIOIF ) ) )
+        {
+            held = event;
+            held_since = sim_now;
+            due = NEVER;
+            sim_bus.stretches++;
+            return 0;
+        }
+    }
+    return 1;
+}
+
+
+static uint8_t acked(void)
+{
+    /* the slave drives SDA low for the acknowledge bit */
+    return ( USICR & ( 1 << USIOIE ) ) && ( DDR_USI & ( 1 << PORT_USI_SDA ) ) && !USIDR;
+}
+
+
+static void schedule(uint8_t ev, uint8_t bits)
+{
+    event = ev;
+    due = sim_now + bits * bit_cycles( );
+}
+
+
+void sim_bus_start(struct sim_transaction *t, uint16_t n, uint64_t at)
+{
+    queue = t;
+    queue_len = n;
+    current = 0;
+    if ( n )
+    {
+        event = EV_START;
+        due = at + (uint64_t)t[0].idle_us * ( F_CPU / 1000000 );
+    }
+}
+
+
+int sim_bus_pending(void)
+{
+    return current < queue_len;
+}
+
+
+uint64_t sim_bus_due(void)
+{
+    return due;
+}
+
+
+static uint8_t rx_count_before;
+
+/* the part of an event after its overflow ISR has released SCL */
+static void finish(uint8_t ev)
+{
+    struct sim_transaction *t = &queue[current];
+
+    switch ( ev )
+    {
+    case EV_ADDRESS:
+        if ( !acked( ) )
+        {
+            sim_bus.nacked++;
+            schedule( EV_STOP, 1 );
+            break;
+        }
+        schedule( EV_ADDR_ACK, 1 );
+        break;
+
+    case EV_ADDR_ACK:
+    case EV_BYTE_ACK:
+        if ( byte_index == t->length )
+        {
+            schedule( EV_STOP, 1 );
+            break;
+        }
+
+        if ( t->type == SIM_BUS_READ )
+        {
+            /* the ISR has loaded the next byte, unless it gave up on the read */
+            uint8_t b = 0xFF;
+            if ( overflowState == USI_SLAVE_REQUEST_REPLY_FROM_SEND_DATA )
+                b = USIDR;
+            else
+                sim_bus.underruns++;
+            sim_bus.read++;
+            if ( !sim_metrics )
+                printf( "line %u: read 0x%02x\n", t->line, b );
+        }
+        schedule( EV_BYTE, 8 );
+        break;
+
+    case EV_BYTE:
+        if ( t->type == SIM_BUS_WRITE )
+        {
+            if ( !acked( ) )
+            {
+                sim_bus.nacked++;
+                schedule( EV_STOP, 1 );
+                break;
+            }
+            if ( rx_count( ) == 0 )
+            {
+                /* the ring buffer wrapped onto unread bytes */
+                sim_bus.overruns++;
+                sim_bus.dropped += rx_count_before + 1;
+            }
+            if ( rx_count( ) > sim_bus.rx_high_water )
+                sim_bus.rx_high_water = rx_count( );
+            rx_line[ rxHead ] = t->line;
+            rx_first[ rxHead ] = ( byte_index == 0 );
+            sim_bus.written++;
+        }
+        byte_index++;
+        schedule( EV_BYTE_ACK, 1 );
+        break;
+    }
+}
+
+
+/* the main program may have released SCL held by an ISR */
+void sim_bus_poll(void)
+{
+    uint8_t ev = held;
+
+    if ( due != NEVER || !( USISR & ( 1 << USIOIF ) ) )
+        return;
+
+    if ( sim_now - held_since > sim_bus.longest_stretch )
+        sim_bus.longest_stretch = sim_now - held_since;
+    event = ev;
+    finish( ev );
+}
+
+
+void sim_bus_step(void)
+{
+    struct sim_transaction *t = &queue[current];
+
+    switch ( event )
+    {
+    case EV_START:
+        sim_bus.transactions++;
+        byte_index = 0;
+        PIN_USI &= ~( ( 1 << PIN_USI_SDA ) | ( 1 << PIN_USI_SCL ) );
+        if ( USICR & ( 1 << USISIE ) )
+        {
+            USISR |= ( 1 << USI_START_COND_INT );
+            latency( &sim_bus.start_latency );
+            sim_now += SIM_CYCLES_ISR_START;
+            USI_START_VECTOR( );
+        }
+        schedule( EV_ADDRESS, 8 );
+        break;
+
+    case EV_ADDRESS:
+        USIDR = ( t->address << 1 ) | t->type;
+        if ( overflow_isr( ) )
+            finish( EV_ADDRESS );
+        break;
+
+    case EV_ADDR_ACK:
+    case EV_BYTE_ACK:
+        if ( t->type == SIM_BUS_READ && event == EV_BYTE_ACK )
+            USIDR = ( byte_index == t->length ) ? 0x80 : 0x00;   /* master NACKs the last byte */
+        else
+            USIDR = 0;
+        if ( overflow_isr( ) )
+            finish( event );
+        break;
+
+    case EV_BYTE:
+        rx_count_before = rx_count( );
+        if ( t->type == SIM_BUS_WRITE )
+            USIDR = t->data[ byte_index ];
+        if ( overflow_isr( ) )
+            finish( EV_BYTE );
+        break;
+
+    case EV_STOP:
+        PIN_USI |= ( 1 << PIN_USI_SDA ) | ( 1 << PIN_USI_SCL );
+        USISR |= ( 1 << USIPF );
+        current++;
+        if ( current < queue_len )
+        {
+            event = EV_START;
+            due = sim_now + bit_cycles( ) + (uint64_t)queue[current].idle_us * ( F_CPU / 1000000 );
+        }
+        break;
+    }
+}
+
+
+uint8_t sim_bus_consumed(uint16_t *line, uint8_t *first, uint8_t *value)
+{
+    if ( seen_tail == rxTail )
+        return 0;
+
+    seen_tail = ( seen_tail + 1 ) & TWI_RX_BUFFER_MASK;
+    *line = rx_line[ seen_tail ];
+    *first = rx_first[ seen_tail ];
+    *value = rxBuf[ seen_tail ];
+    return 1;
+}